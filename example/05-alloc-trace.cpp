@@ -0,0 +1,246 @@
+// Record the clones and deletes of a workload of traced_value_ptr-s, or read
+// a recorded trace, and replay it against three allocators.
+//
+// Usage: 05-alloc-trace [trace-file]
+
+#include "nonstd/value_ptr_trace.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace nonstd;
+
+// the workload: deep copies of a binary tree
+
+struct Node
+{
+    std::string name;
+    traced_value_ptr<Node> left;
+    traced_value_ptr<Node> right;
+
+    Node( std::string const & name_ )
+    : name( name_ ), left(), right()
+    {}
+};
+
+traced_value_ptr<Node> make_tree( int depth )
+{
+    traced_value_ptr<Node> node( Node( "node" ) );
+
+    if ( depth > 1 )
+    {
+        node->left  = make_tree( depth - 1 );
+        node->right = make_tree( depth - 1 );
+    }
+    return node;
+}
+
+void workload()
+{
+    traced_value_ptr<Node> tree = make_tree( 12 );
+    std::vector< traced_value_ptr<Node> > copies;
+
+    for ( int i = 0; i < 16; ++i )
+    {
+        copies.push_back( tree );
+
+        if ( i % 4 == 3 )
+            copies.erase( copies.begin(), copies.begin() + 2 );
+    }
+}
+
+// allocator 1: global operator new and delete
+
+struct default_allocator
+{
+    void * allocate( std::size_t size )
+    {
+        return ::operator new( size );
+    }
+
+    void deallocate( void * p, std::size_t )
+    {
+        ::operator delete( p );
+    }
+};
+
+// allocator 2: free lists per 16-byte size class up to 256 bytes, carved
+// from 64 kB chunks; larger blocks via operator new
+
+class pool_allocator
+{
+public:
+    pool_allocator()
+    : chunks_(), free_( classes, nullptr )
+    {}
+
+    ~pool_allocator()
+    {
+        for ( void * chunk : chunks_ )
+            ::operator delete( chunk );
+    }
+
+    void * allocate( std::size_t size )
+    {
+        if ( size > granule * classes )
+            return ::operator new( size );
+
+        std::size_t const k = size_class( size );
+
+        if ( ! free_[k] )
+            refill( k );
+
+        block * b = free_[k];
+        free_[k] = b->next;
+        return b;
+    }
+
+    void deallocate( void * p, std::size_t size )
+    {
+        if ( size > granule * classes )
+            return ::operator delete( p );
+
+        block * b = static_cast<block *>( p );
+        std::size_t const k = size_class( size );
+
+        b->next = free_[k];
+        free_[k] = b;
+    }
+
+private:
+    struct block { block * next; };
+
+    static std::size_t const granule = 16;
+    static std::size_t const classes = 16;
+    static std::size_t const chunk   = 64 * 1024;
+
+    static std::size_t size_class( std::size_t size )
+    {
+        return size == 0 ? 0 : ( size - 1 ) / granule;
+    }
+
+    void refill( std::size_t k )
+    {
+        std::size_t const size = ( k + 1 ) * granule;
+        char * mem = static_cast<char *>( ::operator new( chunk ) );
+        chunks_.push_back( mem );
+
+        for ( std::size_t offset = 0; offset + size <= chunk; offset += size )
+        {
+            block * b = reinterpret_cast<block *>( mem + offset );
+            b->next = free_[k];
+            free_[k] = b;
+        }
+    }
+
+    std::vector<void *> chunks_;
+    std::vector<block *> free_;
+};
+
+// allocator 3: bump allocation from 1 MB blocks, freed all at once at the end
+
+class arena_allocator
+{
+public:
+    arena_allocator()
+    : blocks_(), next_( nullptr ), end_( nullptr )
+    {}
+
+    ~arena_allocator()
+    {
+        for ( void * b : blocks_ )
+            ::operator delete( b );
+    }
+
+    void * allocate( std::size_t size )
+    {
+        std::size_t const align = alignof( std::max_align_t );
+        size = ( size + align - 1 ) / align * align;
+
+        if ( static_cast<std::size_t>( end_ - next_ ) < size )
+        {
+            std::size_t const length = size > block ? size : block;
+            next_ = static_cast<char *>( ::operator new( length ) );
+            end_  = next_ + length;
+            blocks_.push_back( next_ );
+        }
+
+        void * p = next_;
+        next_ += size;
+        return p;
+    }
+
+    void deallocate( void *, std::size_t )
+    {}
+
+private:
+    static std::size_t const block = 1024 * 1024;
+
+    std::vector<void *> blocks_;
+    char * next_;
+    char * end_;
+};
+
+template< class Allocator >
+void report( char const * name, alloc_trace_data const & trace )
+{
+    Allocator alloc;
+    replay_result const r = replay( trace, alloc );
+
+    std::cout
+        << name << ": "
+        << r.clones << " clones, "
+        << r.deletes << " deletes, "
+        << r.unmatched << " unmatched, peak "
+        << r.peak_bytes << " bytes, "
+        << r.elapsed.count() / 1000 << " us\n";
+}
+
+int main( int argc, char * argv[] )
+{
+    alloc_trace_data trace;
+
+    if ( argc > 1 )
+    {
+        if ( ! load_alloc_trace( argv[1], trace ) )
+        {
+            std::cerr << "Error: cannot read trace '" << argv[1] << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        std::FILE * file = std::tmpfile();
+
+        if ( ! file || ! alloc_trace::start( file ) )
+        {
+            std::cerr << "Error: cannot start trace\n";
+            return EXIT_FAILURE;
+        }
+
+        workload();
+
+        bool const ok = alloc_trace::stop() && ( std::rewind( file ), load_alloc_trace( file, trace ) );
+        std::fclose( file );
+
+        if ( ! ok )
+        {
+            std::cerr << "Error: cannot record trace\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << trace.records.size() << " records of " << trace.types.size() << " type(s)\n";
+
+    report<default_allocator>( "default", trace );
+    report<pool_allocator   >( "pool   ", trace );
+    report<arena_allocator  >( "arena  ", trace );
+}
+
+// cl -EHsc -I../include 05-alloc-trace.cpp && 05-alloc-trace.exe
+// g++ -std=c++11 -I../include -o 05-alloc-trace.exe 05-alloc-trace.cpp && 05-alloc-trace.exe
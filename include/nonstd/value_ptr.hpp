@@ -26,6 +26,34 @@
 # define nsvp_CONFIG_COMPARE_POINTERS  0
 #endif
 
+#ifndef  nsvp_CONFIG_HASH_BYTES
+# define nsvp_CONFIG_HASH_BYTES  0
+#endif
+
+#ifndef  nsvp_CONFIG_STATS
+# define nsvp_CONFIG_STATS  0
+#endif
+
+#ifndef  nsvp_CONFIG_USDT_PROBES
+# define nsvp_CONFIG_USDT_PROBES  0
+#endif
+
+#ifndef  nsvp_CONFIG_COPY_AUDIT
+# define nsvp_CONFIG_COPY_AUDIT  0
+#endif
+
+#ifndef  nsvp_CONFIG_COPY_AUDIT_SAMPLE
+# define nsvp_CONFIG_COPY_AUDIT_SAMPLE  1
+#endif
+
+#ifndef  nsvp_CONFIG_COPY_AUDIT_DEPTH
+# define nsvp_CONFIG_COPY_AUDIT_DEPTH  16
+#endif
+
+#ifndef  nsvp_CONFIG_COPY_AUDIT_AT_EXIT
+# define nsvp_CONFIG_COPY_AUDIT_AT_EXIT  1
+#endif
+
 // Control presence of exception handling (try and auto discover):
 
 #ifndef nsvp_CONFIG_NO_EXCEPTIONS
@@ -154,12 +182,36 @@
 
 // no flag
 
+// Presence of C++20 language features:
+
+#if defined( __cpp_impl_three_way_comparison ) && defined( __has_include )
+# if __has_include( <compare> )
+#  define nsvp_HAVE_THREE_WAY_COMPARISON  nsvp_CPP20_OR_GREATER
+# endif
+#endif
+
+#ifndef   nsvp_HAVE_THREE_WAY_COMPARISON
+# define  nsvp_HAVE_THREE_WAY_COMPARISON  0
+#endif
+
 // Presence of C++ library features:
 
 #define nsvp_HAVE_TR1_TYPE_TRAITS       (!! nsvp_COMPILER_GNUC_VERSION )
 #define nsvp_HAVE_TR1_ADD_POINTER       (!! nsvp_COMPILER_GNUC_VERSION )
 
 #define nsvp_HAVE_TYPE_TRAITS           nsvp_CPP11_90
+#define nsvp_HAVE_IS_TRIVIALLY_COPYABLE  ( nsvp_CPP11_110 && ! nsvp_BETWEEN( nsvp_COMPILER_GNUC_VERSION, 1, 500 ) )
+#define nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS  nsvp_CPP17_000
+
+// Presence of platform features:
+
+#ifndef   nsvp_HAVE_POSIX_IO
+# if defined( __unix__ ) || defined( __APPLE__ )
+#  define nsvp_HAVE_POSIX_IO  1
+# else
+#  define nsvp_HAVE_POSIX_IO  0
+# endif
+#endif
 
 // C++ feature usage:
 
@@ -197,6 +249,17 @@
 # define nsvp_refref_qual  /*&&*/
 #endif
 
+// Software prefetch of the memory at addr into the cache, a no-op if unavailable:
+
+#if nsvp_COMPILER_GNUC_VERSION || nsvp_COMPILER_CLANG_VERSION
+# define nsvp_PREFETCH( addr )  __builtin_prefetch( addr )
+#elif nsvp_COMPILER_MSVC_VER && ( defined(_M_IX86) || defined(_M_X64) )
+# include <xmmintrin.h>
+# define nsvp_PREFETCH( addr )  _mm_prefetch( reinterpret_cast<char const *>( addr ), _MM_HINT_T0 )
+#else
+# define nsvp_PREFETCH( addr )  ( (void)( addr ) )
+#endif
+
 // additional includes:
 
 #if ! nsvp_CPP11_OR_GREATER
@@ -213,6 +276,10 @@
 # include <tr1/type_traits>
 #endif
 
+#if nsvp_HAVE_THREE_WAY_COMPARISON
+# include <compare>
+#endif
+
 // static assert:
 
 #if nsvp_CPP11_OR_GREATER
@@ -250,6 +317,54 @@
 # include <stdexcept>
 #endif
 
+#if nsvp_CONFIG_HASH_BYTES && nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS
+# include <cstdint>
+# include <cstring>
+#endif
+
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstdint>
+# include <mutex>
+# include <string>
+# include <vector>
+#endif
+
+// USDT static probes, via systemtap's <sys/sdt.h>:
+
+#if nsvp_CONFIG_USDT_PROBES && nsvp_CPP11_OR_GREATER
+# if defined( __has_include )
+#  if ! __has_include( <sys/sdt.h> )
+#   error nsvp_CONFIG_USDT_PROBES requires <sys/sdt.h>, e.g. from package systemtap-sdt-dev(el)
+#  endif
+# endif
+# include <sys/sdt.h>
+#endif
+
+// Copy audit, with call stacks via backtrace() where available (glibc, macOS):
+
+#ifndef   nsvp_HAVE_BACKTRACE
+# if defined( __GLIBC__ ) || defined( __APPLE__ )
+#  define nsvp_HAVE_BACKTRACE  1
+# else
+#  define nsvp_HAVE_BACKTRACE  0
+# endif
+#endif
+
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER
+# include <algorithm>
+# include <cstdint>
+# include <cstdio>
+# include <cstdlib>
+# include <mutex>
+# include <string>
+# include <unordered_map>
+# include <vector>
+# if nsvp_HAVE_BACKTRACE
+#  include <execinfo.h>
+# endif
+#endif
+
 //
 // in_place: code duplicated in any-lite, expected-lite, optional-lite, value-ptr-lite, variant-lite:
 //
@@ -362,6 +477,90 @@ struct remove_cvref
 
 namespace detail {
 
+#if nsvp_CONFIG_HASH_BYTES && nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS
+
+// hash object bytes, a 64-bit word at a time (MurmurHash64A):
+
+inline std::size_t hash_bytes( void const * data, std::size_t size ) nsvp_noexcept
+{
+    std::uint64_t const m = 0xc6a4a7935bd1e995ULL;
+    int           const r = 47;
+
+    unsigned char const * pos = static_cast<unsigned char const *>( data );
+    std::uint64_t h = 0x9e3779b97f4a7c15ULL ^ ( size * m );
+
+    for ( ; size >= sizeof( std::uint64_t ); pos += sizeof( std::uint64_t ), size -= sizeof( std::uint64_t ) )
+    {
+        std::uint64_t k;
+        std::memcpy( &k, pos, sizeof( k ) );
+
+        k *= m; k ^= k >> r; k *= m;
+        h ^= k; h *= m;
+    }
+
+    if ( size > 0 )
+    {
+        std::uint64_t k = 0;
+        std::memcpy( &k, pos, size );
+
+        h ^= k; h *= m;
+    }
+
+    h ^= h >> r; h *= m; h ^= h >> r;
+
+    return static_cast<std::size_t>( h );
+}
+
+#endif // nsvp_CONFIG_HASH_BYTES
+
+#if nsvp_CPP11_OR_GREATER
+
+// hash content over its bytes if so configured and the type allows it; equal
+// values must have equal bytes, which only has_unique_object_representations
+// guarantees (no padding, no floating point), hence not before C++17:
+
+template< class T >
+struct hash_as_bytes : std::integral_constant< bool,
+#if nsvp_CONFIG_HASH_BYTES && nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS
+    std::is_trivially_copyable<T>::value
+    && std::has_unique_object_representations<T>::value
+#else
+    false
+#endif
+> {};
+
+template< class T, bool = hash_as_bytes<T>::value >
+struct content_hash
+{
+    std::size_t operator()( T const & value ) const
+    {
+        return std::hash<T>()( value );
+    }
+};
+
+#if nsvp_CONFIG_HASH_BYTES && nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS
+
+template< class T >
+struct content_hash< T, true >
+{
+    std::size_t operator()( T const & value ) const nsvp_noexcept
+    {
+        return hash_bytes( &value, sizeof( T ) );
+    }
+};
+
+#endif // nsvp_CONFIG_HASH_BYTES
+
+// hash of the pointee, with a fixed value for empty:
+
+template< class T >
+inline std::size_t hash_content( T const * ptr )
+{
+    return ptr ? content_hash<T>()( *ptr ) : static_cast<std::size_t>( 0x7a3c9e1dUL );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
 #if nsvp_CPP11_OR_GREATER
 using std::default_delete;
 #else
@@ -419,6 +618,545 @@ struct default_clone
 #endif
 };
 
+// swap the state of a cloner or deleter along with the pointer it belongs to,
+// unless it is empty; state that cannot be swapped (e.g. a capturing lambda)
+// is rejected, as the pointer would end up with the other's cloner or deleter:
+
+#if nsvp_CPP11_OR_GREATER
+
+template< class F >
+inline void swap_state( F & a, F & b, std::true_type )
+{
+    using std::swap;
+    swap( a, b );
+}
+
+template< class F >
+inline void swap_state( F &, F &, std::false_type ) nsvp_noexcept
+{}
+
+template< class F >
+inline void swap_state( F & a, F & b )
+{
+    nsvp_static_assert( std::is_empty<F>::value || ( std::is_move_constructible<F>::value && std::is_move_assignable<F>::value ),
+        "value_ptr: swap() and move assignment require a cloner and deleter that are empty or move-assignable" );
+
+    swap_state( a, b, std::integral_constant<bool, ! std::is_empty<F>::value >() );
+}
+
+#else
+
+template< class F >
+inline void swap_state( F & a, F & b )
+{
+    using std::swap;
+    swap( a, b );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+#if nsvp_CPP11_OR_GREATER
+
+// name of type T, the text of signature between the first open and the last
+// close, with static storage that is never destroyed, for use at exit:
+
+inline char const * find_text( char const * text, char const * pattern ) nsvp_noexcept
+{
+    for ( ; *text; ++text )
+    {
+        char const * t = text;
+        char const * p = pattern;
+
+        for ( ; *p && *t == *p; ++t, ++p ) {}
+
+        if ( ! *p )
+            return text;
+    }
+    return nsvp_nullptr;
+}
+
+inline char const * type_name_of( char const * signature, char const * open, char const * close )
+{
+    char const * first = find_text( signature, open );
+
+    if ( ! first )
+        return "unknown";
+
+    while ( *open++ )
+        ++first;
+
+    char const * last = nsvp_nullptr;
+
+    for ( char const * pos = find_text( first, close ); pos; pos = find_text( pos + 1, close ) )
+        last = pos;
+
+    if ( ! last )
+        return "unknown";
+
+    std::size_t const length = static_cast<std::size_t>( last - first );
+    char * name = new char[ length + 1 ];
+
+    for ( std::size_t i = 0; i != length; ++i )
+        name[i] = first[i];
+
+    name[ length ] = '\0';
+    return name;
+}
+
+template< class T >
+inline char const * type_name_c_str()
+{
+#if defined( __clang__ ) || defined( __GNUC__ )
+    static char const * const name = type_name_of( __PRETTY_FUNCTION__, "T = ", "]" );
+#elif defined( _MSC_VER )
+    static char const * const name = type_name_of( __FUNCSIG__, "type_name_c_str<", ">(void)" );
+#else
+    static char const * const name = "unknown";
+#endif
+    return name;
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+// Statistics of clones and deletes per element type, nsvp_CONFIG_STATS:
+
+struct stats_event
+{
+    enum type { clone, adopt, release, destroy };
+};
+
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+
+// counters of one thread for one type, written by that thread only:
+
+struct stats_shard
+{
+    std::atomic<std::uint64_t> counts[4];   // by stats_event
+    std::int64_t pending;                   // change of live objects, not yet in type_stats::live
+    bool exited;                            // thread exit has published pending, publish at once
+};
+
+// counters of one type, the sum of its shards:
+
+class type_stats
+{
+public:
+    // pending changes of live objects are published in batches, hence peak
+    // may lag by up to this many objects per thread:
+
+    static std::int64_t const batch = 32;
+
+    type_stats( std::string const & name, std::size_t size )
+    : name_( name ), size_( size ), mutex_(), shards_(), live_( 0 ), peak_( 0 )
+    {}
+
+    static std::vector<type_stats *> & all()
+    {
+        static std::vector<type_stats *> * types = new std::vector<type_stats *>();
+        return *types;
+    }
+
+    static std::mutex & all_mutex()
+    {
+        static std::mutex * mutex = new std::mutex();
+        return *mutex;
+    }
+
+    // never destroyed, so that counts remain available to the end:
+
+    template< class T >
+    static type_stats & of()
+    {
+        static type_stats * stats = enroll( new type_stats( type_name_c_str<T>(), sizeof( T ) ) );
+        return *stats;
+    }
+
+    stats_shard * add_shard()
+    {
+        std::unique_ptr<stats_shard> shard( new stats_shard() );
+
+        for ( auto & count : shard->counts )
+            count.store( 0, std::memory_order_relaxed );
+        shard->pending = 0;
+        shard->exited  = false;
+
+        std::lock_guard<std::mutex> lock( mutex_ );
+        shards_.push_back( shard.get() );
+        return shard.release();
+    }
+
+    void publish( stats_shard & shard ) nsvp_noexcept
+    {
+        std::int64_t const live = live_.fetch_add( shard.pending, std::memory_order_relaxed ) + shard.pending;
+        std::int64_t peak = peak_.load( std::memory_order_relaxed );
+
+        while ( live > peak && ! peak_.compare_exchange_weak( peak, live, std::memory_order_relaxed ) )
+        {}
+
+        shard.pending = 0;
+    }
+
+    std::string const & name() const nsvp_noexcept
+    {
+        return name_;
+    }
+
+    std::size_t size() const nsvp_noexcept
+    {
+        return size_;
+    }
+
+    // sum of the counts of all shards, by stats_event:
+
+    void sum( std::uint64_t (&counts)[4] ) const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        for ( std::uint64_t & count : counts )
+            count = 0;
+
+        for ( stats_shard const * shard : shards_ )
+            for ( std::size_t i = 0; i != 4; ++i )
+                counts[i] += shard->counts[i].load( std::memory_order_relaxed );
+    }
+
+    // live objects as published, see batch:
+
+    std::int64_t live() const nsvp_noexcept
+    {
+        return live_.load( std::memory_order_relaxed );
+    }
+
+    std::int64_t peak() const nsvp_noexcept
+    {
+        return peak_.load( std::memory_order_relaxed );
+    }
+
+private:
+    static type_stats * enroll( type_stats * stats )
+    {
+        std::lock_guard<std::mutex> lock( all_mutex() );
+        all().push_back( stats );
+        return stats;
+    }
+
+    std::string name_;
+    std::size_t size_;
+    mutable std::mutex mutex_;
+    std::vector<stats_shard *> shards_;
+    std::atomic<std::int64_t> live_;
+    std::atomic<std::int64_t> peak_;
+};
+
+// shard of the current thread for type T; its pending changes are published
+// at thread exit. Shards are never destroyed and the pointer to the shard is
+// trivially destructible, so that a value_ptr destroyed by another
+// thread_local object after the publication still finds its shard:
+
+template< class T >
+inline stats_shard & stats_shard_of()
+{
+    struct publisher
+    {
+        type_stats * stats;
+        stats_shard * shard;
+
+        ~publisher()
+        {
+            stats->publish( *shard );
+            shard->exited = true;
+        }
+    };
+
+    static thread_local stats_shard * shard = nullptr;
+
+    if ( ! shard )
+    {
+        type_stats & stats = type_stats::of<T>();
+        shard = stats.add_shard();
+
+        static thread_local publisher const at_exit = { &stats, shard };
+        (void) at_exit;
+    }
+    return *shard;
+}
+
+template< class T >
+inline void stats_count( stats_event::type event, T const * ptr )
+{
+    if ( ! ptr )
+        return;
+
+    stats_shard & shard = stats_shard_of<T>();
+    std::atomic<std::uint64_t> & count = shard.counts[ event ];
+
+    count.fetch_add( 1, std::memory_order_relaxed );
+
+    shard.pending += event == stats_event::clone || event == stats_event::adopt ? 1 : -1;
+
+    if ( shard.exited || shard.pending >= type_stats::batch || shard.pending <= -type_stats::batch )
+        type_stats::of<T>().publish( shard );
+}
+
+#else // nsvp_CONFIG_STATS
+
+template< class T >
+inline void stats_count( stats_event::type, T const * ) nsvp_noexcept
+{}
+
+#endif // nsvp_CONFIG_STATS
+
+// USDT probes nsvp:clone, nsvp:adopt, nsvp:release and nsvp:delete, with
+// arguments type name, size and pointer, nsvp_CONFIG_USDT_PROBES:
+
+#if nsvp_CONFIG_USDT_PROBES && nsvp_CPP11_OR_GREATER
+
+template< class T >
+inline void probe_event( stats_event::type event, T const * ptr ) nsvp_noexcept
+{
+    if ( ! ptr )
+        return;
+
+    char const * const name = type_name_c_str<T>();
+    std::size_t  const size = sizeof( T );
+    void const * const addr = ptr;
+
+    switch ( event )
+    {
+        case stats_event::clone:   DTRACE_PROBE3( nsvp, clone,   name, size, addr ); break;
+        case stats_event::adopt:   DTRACE_PROBE3( nsvp, adopt,   name, size, addr ); break;
+        case stats_event::release: DTRACE_PROBE3( nsvp, release, name, size, addr ); break;
+        case stats_event::destroy: DTRACE_PROBE3( nsvp, delete,  name, size, addr ); break;
+    }
+}
+
+#else // nsvp_CONFIG_USDT_PROBES
+
+template< class T >
+inline void probe_event( stats_event::type, T const * ) nsvp_noexcept
+{}
+
+#endif // nsvp_CONFIG_USDT_PROBES
+
+// report an ownership event of compressed_ptr to the enabled observers:
+
+template< class T >
+inline void observe( stats_event::type event, T const * ptr )
+{
+    stats_count( event, ptr );
+    probe_event( event, ptr );
+}
+
+// Audit of deep copies of value_ptr-s by call site, nsvp_CONFIG_COPY_AUDIT:
+
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER
+
+// deep copies of trees rooted at one element type from one call stack:
+
+struct copy_site
+{
+    char const *        type;       // from type_name_c_str(), unique per type
+    std::size_t         size;       // sizeof element type
+    std::vector<void *> frames;     // return addresses, innermost first
+
+    bool operator==( copy_site const & other ) const
+    {
+        return type == other.type && frames == other.frames;
+    }
+};
+
+struct copy_site_hash
+{
+    std::size_t operator()( copy_site const & site ) const nsvp_noexcept
+    {
+        std::size_t h = std::hash<void const *>()( site.type );
+
+        for ( void * frame : site.frames )
+            h = h * 31u + std::hash<void *>()( frame );
+
+        return h;
+    }
+};
+
+// sampled copies per call site, never destroyed so that it can be
+// reported at exit:
+
+class copy_audit_log
+{
+public:
+    static copy_audit_log & instance()
+    {
+        static copy_audit_log * log = new copy_audit_log();
+        return *log;
+    }
+
+    struct totals
+    {
+        std::uint64_t copies;   // sampled copies
+        std::uint64_t bytes;    // sizeof element type, summed over the nodes copied
+    };
+
+    void record( char const * type, std::size_t size, std::uint64_t bytes, void * const * frames, std::size_t count )
+    {
+        copy_site site = { type, size, std::vector<void *>( frames, frames + count ) };
+
+        std::lock_guard<std::mutex> lock( mutex_ );
+        totals & t = sites_[ site ];
+        t.copies += 1;
+        t.bytes  += bytes;
+    }
+
+    template< class F >
+    void for_each( F f ) const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        for ( auto const & site : sites_ )
+            f( site.first, site.second );
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        sites_.clear();
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return sites_.empty();
+    }
+
+private:
+    copy_audit_log()
+    : mutex_(), sites_()
+    {
+#if nsvp_CONFIG_COPY_AUDIT_AT_EXIT
+        std::atexit( &report_at_exit );
+#endif
+    }
+
+    static void report_at_exit();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<copy_site, totals, copy_site_hash> sites_;
+};
+
+// true for every nsvp_CONFIG_COPY_AUDIT_SAMPLE-th copy of the current thread:
+
+inline bool copy_audit_due() nsvp_noexcept
+{
+    static thread_local std::uint64_t copies = 0;
+    return ++copies % nsvp_CONFIG_COPY_AUDIT_SAMPLE == 0;
+}
+
+// a deep copy of a tree of value_ptr-s copies each node via a nested copy;
+// only the outermost copy of the current thread is recorded, with the bytes
+// of all nodes copied below it:
+
+class copy_audit_scope
+{
+public:
+    copy_audit_scope() nsvp_noexcept
+    {
+        ++state().depth;
+    }
+
+    ~copy_audit_scope()
+    {
+        if ( --state().depth == 0 )
+            state().bytes = 0;
+    }
+
+    copy_audit_scope( copy_audit_scope const & ) = delete;
+    copy_audit_scope & operator=( copy_audit_scope const & ) = delete;
+
+    // count the node copied in this scope, and record the copy if it is the outermost:
+
+    template< class T >
+    void done( T const * ptr )
+    {
+        if ( ! ptr )
+            return;
+
+        state().bytes += sizeof( T );
+
+        if ( state().depth != 1 || ! copy_audit_due() )
+            return;
+
+        void * frames[ nsvp_CONFIG_COPY_AUDIT_DEPTH ];
+#if nsvp_HAVE_BACKTRACE
+        int const depth = ::backtrace( frames, nsvp_CONFIG_COPY_AUDIT_DEPTH );
+        std::size_t const count = depth > 0 ? std::size_t( depth ) : 0;
+#else
+        std::size_t const count = 0;
+#endif
+        copy_audit_log::instance().record( type_name_c_str<T>(), sizeof( T ), state().bytes, frames, count );
+    }
+
+private:
+    struct nesting
+    {
+        unsigned      depth;
+        std::uint64_t bytes;
+    };
+
+    static nesting & state() nsvp_noexcept
+    {
+        static thread_local nesting current = { 0, 0 };
+        return current;
+    }
+};
+
+#else // nsvp_CONFIG_COPY_AUDIT
+
+struct copy_audit_scope
+{
+    template< class T >
+    void done( T const * ) nsvp_noexcept
+    {}
+};
+
+#endif // nsvp_CONFIG_COPY_AUDIT
+
+// clone via cloner( value, hint ) if the cloner accepts a placement hint,
+// the address of the owning object, else via cloner( value ):
+
+#if nsvp_CPP11_OR_GREATER
+
+template< class C, class V >
+inline auto clone_hinted( C & cloner, V && value, void const * hint, int )
+    -> decltype( cloner( std::forward<V>( value ), hint ) )
+{
+    return cloner( std::forward<V>( value ), hint );
+}
+
+template< class C, class V >
+inline auto clone_hinted( C & cloner, V && value, void const *, long )
+    -> decltype( cloner( std::forward<V>( value ) ) )
+{
+    return cloner( std::forward<V>( value ) );
+}
+
+// copy the content of a value_ptr via cloner.copy( value ) if the cloner
+// provides it, as value stems from a cloner of the same type, else clone it:
+
+template< class C, class T >
+inline auto clone_owned( C & cloner, T const & value, void const *, int )
+    -> decltype( cloner.copy( value ) )
+{
+    return cloner.copy( value );
+}
+
+template< class C, class T >
+inline auto clone_owned( C & cloner, T const & value, void const * hint, long )
+    -> decltype( clone_hinted( cloner, value, hint, 0 ) )
+{
+    return clone_hinted( cloner, value, hint, 0 );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
 template <class T, class Cloner, class Deleter>
 struct nsvp_DECLSPEC_EMPTY_BASES compressed_ptr : Cloner, Deleter
 {
@@ -432,7 +1170,8 @@ struct nsvp_DECLSPEC_EMPTY_BASES compressed_ptr : Cloner, Deleter
 
     ~compressed_ptr()
     {
-        deleter_type()( ptr );
+        observe( stats_event::destroy, ptr );
+        get_deleter()( ptr );
     }
 
     compressed_ptr() nsvp_noexcept
@@ -441,12 +1180,23 @@ struct nsvp_DECLSPEC_EMPTY_BASES compressed_ptr : Cloner, Deleter
 
     compressed_ptr( pointer p ) nsvp_noexcept
     : ptr( p )
-    {}
+    {
+        observe( stats_event::adopt, ptr );
+    }
+
+#if  nsvp_CPP11_OR_GREATER
+    compressed_ptr( pointer p, deleter_type && deleter ) nsvp_noexcept
+    : deleter_type( std::move( deleter ) )
+    , ptr( p )
+    {
+        observe( stats_event::adopt, ptr );
+    }
+#endif
 
     compressed_ptr( compressed_ptr const & other )
     : cloner_type ( other )
     , deleter_type( other )
-    , ptr( other.ptr ? cloner_type()( *other.ptr ) : nsvp_nullptr )
+    , ptr( other.ptr ? copy_of( *other.ptr ) : nsvp_nullptr )
     {}
 
 #if  nsvp_CPP11_OR_GREATER
@@ -460,50 +1210,54 @@ struct nsvp_DECLSPEC_EMPTY_BASES compressed_ptr : Cloner, Deleter
 #endif
 
     compressed_ptr( element_type const & value )
-    : ptr( cloner_type()( value ) )
+    : ptr( clone_of( value ) )
     {}
 
 #if  nsvp_CPP11_OR_GREATER
 
     compressed_ptr( element_type && value ) nsvp_noexcept
-    : ptr( cloner_type()( std::move( value ) ) )
+    : ptr( clone_of( std::move( value ) ) )
     {}
 
     template< class... Args >
     explicit compressed_ptr( nonstd_lite_in_place_t(T), Args&&... args )
-    : ptr( cloner_type()( nonstd_lite_in_place(T), std::forward<Args>(args)...) )
-    {}
+    : ptr( get_cloner()( nonstd_lite_in_place(T), std::forward<Args>(args)...) )
+    {
+        observe( stats_event::clone, ptr );
+    }
 
     template< class U, class... Args >
     explicit compressed_ptr( nonstd_lite_in_place_t(T), std::initializer_list<U> il, Args&&... args )
-    : ptr( cloner_type()( nonstd_lite_in_place(T), il, std::forward<Args>(args)...) )
-    {}
+    : ptr( get_cloner()( nonstd_lite_in_place(T), il, std::forward<Args>(args)...) )
+    {
+        observe( stats_event::clone, ptr );
+    }
 
 #endif
 
     compressed_ptr( element_type const & value, cloner_type const & cloner )
     : cloner_type ( cloner  )
-    , ptr( cloner_type()( value ) )
+    , ptr( clone_of( value ) )
     {}
 
 #if  nsvp_CPP11_OR_GREATER
     compressed_ptr( element_type && value, cloner_type && cloner ) nsvp_noexcept
     : cloner_type ( std::move( cloner  ) )
-    , ptr( cloner_type()( std::move( value ) ) )
+    , ptr( clone_of( std::move( value ) ) )
     {}
 #endif
 
     compressed_ptr( element_type const & value, cloner_type const & cloner, deleter_type const & deleter )
     : cloner_type ( cloner  )
     , deleter_type( deleter )
-    , ptr( cloner_type()( value ) )
+    , ptr( clone_of( value ) )
     {}
 
 #if  nsvp_CPP11_OR_GREATER
     compressed_ptr( element_type && value, cloner_type && cloner, deleter_type && deleter ) nsvp_noexcept
     : cloner_type ( std::move( cloner  ) )
     , deleter_type( std::move( deleter ) )
-    , ptr( cloner_type()( std::move( value ) ) )
+    , ptr( clone_of( std::move( value ) ) )
     {}
 #endif
 
@@ -547,60 +1301,263 @@ struct nsvp_DECLSPEC_EMPTY_BASES compressed_ptr : Cloner, Deleter
 
     // Observers:
 
-    pointer get() const nsvp_noexcept
+    pointer get() const nsvp_noexcept
+    {
+        return ptr;
+    }
+
+    cloner_type & get_cloner() nsvp_noexcept
+    {
+        return *this;
+    }
+
+    deleter_type & get_deleter() nsvp_noexcept
+    {
+        return *this;
+    }
+
+    // Modifiers:
+
+    pointer release() nsvp_noexcept
+    {
+        using std::swap;
+        pointer result = nsvp_nullptr;
+        swap( result, ptr );
+        observe( stats_event::release, result );
+        return result;
+    }
+
+    void reset( pointer p ) nsvp_noexcept
+    {
+        observe( stats_event::adopt, p );
+        replace( p );
+    }
+
+    void reset( element_type const & v )
+    {
+        replace( clone_of( v ) );
+    }
+
+#if  nsvp_CPP11_OR_GREATER
+    void reset( element_type && v )
+    {
+        replace( clone_of( std::move( v ) ) );
+    }
+#endif
+
+    void swap( compressed_ptr & other ) nsvp_noexcept
+    {
+        using std::swap;
+        swap( ptr, other.ptr );
+        swap_state( get_cloner() , other.get_cloner()  );
+        swap_state( get_deleter(), other.get_deleter() );
+    }
+
+    // Cloning, with this object's address as placement hint:
+
+#if  nsvp_CPP11_OR_GREATER
+    template< class V >
+    pointer clone_of( V && value )
+    {
+        pointer result = clone_hinted( get_cloner(), std::forward<V>( value ), static_cast<void const *>( this ), 0 );
+        observe( stats_event::clone, result );
+        return result;
+    }
+#else
+    pointer clone_of( element_type const & value )
+    {
+        return get_cloner()( value );
+    }
+#endif
+
+    // deep copy, as opposed to cloning a value, subject to the copy audit:
+
+    pointer copy_of( element_type const & value )
+    {
+        copy_audit_scope scope;
+#if  nsvp_CPP11_OR_GREATER
+        pointer result = clone_owned( get_cloner(), value, static_cast<void const *>( this ), 0 );
+        observe( stats_event::clone, result );
+#else
+        pointer result = clone_of( value );
+#endif
+        scope.done( result );
+        return result;
+    }
+
+    // delete the current object and take ownership of p:
+
+    void replace( pointer p ) nsvp_noexcept
+    {
+        observe( stats_event::destroy, ptr );
+        get_deleter()( ptr );
+        ptr = p;
+    }
+
+    pointer ptr;
+};
+
+} // namespace detail
+
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+
+// statistics of value_ptr-s per element type, see nsvp_CONFIG_STATS:
+
+struct value_ptr_stats
+{
+    struct entry
+    {
+        std::string   type;             // element type name
+        std::size_t   size;             // sizeof element type
+        std::uint64_t clones;           // objects created via the cloner
+        std::uint64_t adopts;           // pointers taken ownership of
+        std::uint64_t releases;         // pointers given up via release()
+        std::uint64_t deletes;          // objects passed to the deleter
+        std::uint64_t bytes_allocated;  // size * clones
+        std::uint64_t live;             // clones + adopts - releases - deletes
+        std::uint64_t peak;             // maximum of live, see type_stats::batch
+    };
+
+    // counts of all types that have been used, in order of first use:
+
+    static std::vector<entry> snapshot()
+    {
+        std::vector<detail::type_stats *> types;
+        {
+            std::lock_guard<std::mutex> lock( detail::type_stats::all_mutex() );
+            types = detail::type_stats::all();
+        }
+
+        std::vector<entry> result;
+
+        for ( detail::type_stats const * stats : types )
+        {
+            std::uint64_t counts[4];
+            stats->sum( counts );
+
+            entry e;
+            e.type     = stats->name();
+            e.size     = stats->size();
+            e.clones   = counts[ detail::stats_event::clone   ];
+            e.adopts   = counts[ detail::stats_event::adopt   ];
+            e.releases = counts[ detail::stats_event::release ];
+            e.deletes  = counts[ detail::stats_event::destroy ];
+            e.bytes_allocated = e.size * e.clones;
+
+            std::uint64_t const in  = e.clones + e.adopts;
+            std::uint64_t const out = e.releases + e.deletes;
+            e.live = in > out ? in - out : 0;
+
+            std::int64_t const peak = stats->peak();
+            e.peak = peak > 0 && std::uint64_t( peak ) > e.live ? std::uint64_t( peak ) : e.live;
+
+            result.push_back( e );
+        }
+        return result;
+    }
+};
+
+#endif // nsvp_CONFIG_STATS
+
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER
+
+// deep copies of value_ptr-s by call site, see nsvp_CONFIG_COPY_AUDIT:
+
+struct copy_audit
+{
+    struct entry
     {
-        return ptr;
-    }
-
-    cloner_type & get_cloner() nsvp_noexcept
+        std::string         type;       // element type name
+        std::size_t         size;       // sizeof element type of the copied root
+        std::uint64_t       copies;     // sampled copies times sample rate
+        std::uint64_t       bytes;      // bytes of all nodes copied, times sample rate
+        std::vector<void *> frames;     // call stack, innermost first, empty without backtrace()
+    };
+
+    static std::uint64_t sample_rate() nsvp_noexcept
     {
-        return *this;
+        return nsvp_CONFIG_COPY_AUDIT_SAMPLE;
     }
 
-    deleter_type & get_deleter() nsvp_noexcept
+    // call sites, most bytes copied first:
+
+    static std::vector<entry> snapshot()
     {
-        return *this;
-    }
+        std::vector<entry> result;
 
-    // Modifiers:
+        detail::copy_audit_log::instance().for_each(
+            [&result]( detail::copy_site const & site, detail::copy_audit_log::totals const & t )
+        {
+            entry e;
+            e.type   = site.type;
+            e.size   = site.size;
+            e.copies = t.copies * sample_rate();
+            e.bytes  = t.bytes  * sample_rate();
+            e.frames = site.frames;
+            result.push_back( e );
+        } );
+
+        std::stable_sort( result.begin(), result.end(), []( entry const & a, entry const & b )
+        {
+            return a.bytes != b.bytes ? a.bytes > b.bytes : a.copies > b.copies;
+        } );
 
-    pointer release() nsvp_noexcept
-    {
-        using std::swap;
-        pointer result = nsvp_nullptr;
-        swap( result, ptr );
         return result;
     }
 
-    void reset( pointer p ) nsvp_noexcept
-    {
-        get_deleter()( ptr );
-        ptr = p;
-    }
+    // print the top call sites, with symbols as far as backtrace_symbols() finds them:
 
-    void reset( element_type const & v )
+    static void report( std::FILE * out = stderr, std::size_t top = 10 )
     {
-        reset( get_cloner()( v ) );
-    }
+        std::vector<entry> const sites = snapshot();
 
-#if  nsvp_CPP11_OR_GREATER
-    void reset( element_type && v )
-    {
-        reset( get_cloner()( std::move( v ) ) );
-    }
+        std::fprintf( out, "value_ptr copy audit: %zu call site(s), sampling 1 in %llu copies\n",
+            sites.size(), static_cast<unsigned long long>( sample_rate() ) );
+
+        for ( std::size_t i = 0; i != sites.size() && i != top; ++i )
+        {
+            entry const & e = sites[i];
+
+            std::fprintf( out, "#%zu: %llu copies, %llu bytes of %s (%zu bytes)\n", i + 1,
+                static_cast<unsigned long long>( e.copies ), static_cast<unsigned long long>( e.bytes ), e.type.c_str(), e.size );
+
+#if nsvp_HAVE_BACKTRACE
+            char ** const symbols = e.frames.empty() ? nsvp_nullptr
+                : ::backtrace_symbols( e.frames.data(), static_cast<int>( e.frames.size() ) );
+
+            for ( std::size_t k = 0; k != e.frames.size(); ++k )
+            {
+                if ( symbols ) std::fprintf( out, "    %s\n", symbols[k] );
+                else           std::fprintf( out, "    %p\n", e.frames[k] );
+            }
+            std::free( symbols );
 #endif
+        }
+        std::fflush( out );
+    }
 
-    void swap( compressed_ptr & other ) nsvp_noexcept
+    // forget the copies recorded so far, e.g. to audit a single phase:
+
+    static void clear()
     {
-        using std::swap;
-        swap( ptr, other.ptr );
+        detail::copy_audit_log::instance().clear();
     }
-
-    pointer ptr;
 };
 
+namespace detail {
+
+inline void copy_audit_log::report_at_exit()
+{
+    if ( instance().empty() )
+        return;
+
+    copy_audit::report( stderr );
+}
+
 } // namespace detail
 
+#endif // nsvp_CONFIG_COPY_AUDIT
+
 #if ! nsvp_CONFIG_NO_EXCEPTIONS
 
 // value_ptr access error
@@ -614,6 +1571,45 @@ public:
 
 #endif
 
+#if nsvp_CPP11_OR_GREATER
+
+// Trees of value_ptr-s: the children of a node are enumerated via an
+// unqualified call visit_children( node, f ), found by argument-dependent
+// lookup, that calls f( link ) for each value_ptr link of the node. Types
+// without visit_children() have no children.
+
+namespace detail {
+
+template< class T, class F >
+inline auto visit_children_of( T & node, F & f, int ) -> decltype( visit_children( node, f ), void() )
+{
+    visit_children( node, f );
+}
+
+template< class T, class F >
+inline void visit_children_of( T &, F &, long ) nsvp_noexcept
+{}
+
+// collects the links of a node into links, a container of Link *:
+
+template< class Link, class Links >
+struct collect_links
+{
+    Links & links;
+
+    template< class Child >
+    void operator()( Child & link ) const
+    {
+        nsvp_static_assert( ( std::is_same<Child, Link>::value ), "children must be of the same value_ptr type as the root" );
+
+        links.push_back( &link );
+    }
+};
+
+} // namespace detail
+
+#endif // nsvp_CPP11_OR_GREATER
+
 // class value_ptr:
 
 template
@@ -654,6 +1650,22 @@ public:
     : ptr( p )
     {}
 
+#if nsvp_CPP11_OR_GREATER
+
+    // adopt the object owned by a unique_ptr with a compatible deleter, without cloning:
+
+    template< class E
+        nsvp_REQUIRES_T(
+            std::is_constructible<deleter_type, E&&>::value )
+    >
+    explicit value_ptr( std::unique_ptr<T, E> && up )
+    : ptr( up.get(), deleter_type( std::forward<E>( up.get_deleter() ) ) )
+    {
+        up.release();
+    }
+
+#endif
+
     value_ptr( value_ptr const & other )
     : ptr( other.ptr )
     {}
@@ -773,7 +1785,7 @@ public:
         if ( this == &rhs )
             return *this;
 
-        if ( rhs ) ptr.reset( *rhs );
+        if ( rhs ) ptr.replace( ptr.copy_of( *rhs ) );
 #if nsvp_HAVE_NULLPTR
         else       ptr.reset( nullptr );
 #else
@@ -825,11 +1837,20 @@ public:
         return ptr.get_deleter();
     }
 
-    reference operator*() const
+    reference operator*() const nsvp_ref_qual
     {
         assert( get() != nsvp_nullptr ); return *get();
     }
 
+#if nsvp_HAVE_REF_QUALIFIER
+
+    element_type && operator*() nsvp_refref_qual
+    {
+        assert( get() != nsvp_nullptr ); return std::move( *get() );
+    }
+
+#endif
+
     pointer operator->() const nsvp_noexcept
     {
         assert( get() != nsvp_nullptr ); return get();
@@ -857,7 +1878,14 @@ public:
         return !! get();
     }
 
-    element_type const & value() const
+    // prefetch the content into the cache, ahead of its use:
+
+    void prefetch() const nsvp_noexcept
+    {
+        nsvp_PREFETCH( get() );
+    }
+
+    element_type const & value() const nsvp_ref_qual
     {
 #if nsvp_CONFIG_NO_EXCEPTIONS
         assert( has_value() );
@@ -870,7 +1898,7 @@ public:
         return *get();
     }
 
-    element_type & value()
+    element_type & value() nsvp_ref_qual
     {
 #if nsvp_CONFIG_NO_EXCEPTIONS
         assert( has_value() );
@@ -883,14 +1911,40 @@ public:
         return *get();
     }
 
+#if nsvp_HAVE_REF_QUALIFIER
+
+    element_type const && value() const nsvp_refref_qual
+    {
+        return std::move( this->value() );
+    }
+
+    element_type && value() nsvp_refref_qual
+    {
+        return std::move( this->value() );
+    }
+
+#endif
+
 #if nsvp_CPP11_OR_GREATER
 
     template< class U >
-    element_type value_or( U && v ) const
+    element_type value_or( U && v ) const nsvp_ref_qual
     {
         return has_value() ? value() : static_cast<element_type>(std::forward<U>( v ) );
     }
 
+#if nsvp_HAVE_REF_QUALIFIER
+
+    // move out of the pointee, instead of copying it:
+
+    template< class U >
+    element_type value_or( U && v ) nsvp_refref_qual
+    {
+        return has_value() ? std::move( this->value() ) : static_cast<element_type>(std::forward<U>( v ) );
+    }
+
+#endif
+
 #else
 
     template< class U >
@@ -908,6 +1962,19 @@ public:
         return ptr.release();
     }
 
+    // move out the value and disengage:
+
+    element_type take()
+    {
+#if nsvp_CPP11_OR_GREATER
+        element_type result( std::move( value() ) );
+#else
+        element_type result( value() );
+#endif
+        reset();
+        return result;
+    }
+
     void reset( pointer p = pointer() ) nsvp_noexcept
     {
         ptr.reset( p );
@@ -918,6 +1985,36 @@ public:
         ptr.swap( other.ptr );
     }
 
+#if nsvp_CPP11_OR_GREATER
+
+    // Copy, consulting given clone context, see nonstd/value_ptr_clone.hpp:
+
+    template< class Context >
+    value_ptr clone_with( Context & ctx ) const
+    {
+        typename Context::scope guard( ctx );
+        return value_ptr( *this );
+    }
+
+    // Conversion, transferring ownership without cloning:
+
+    std::unique_ptr<T, deleter_type> to_unique() nsvp_refref_qual
+    {
+        deleter_type deleter( std::move( get_deleter() ) );
+        return std::unique_ptr<T, deleter_type>( release(), std::move( deleter ) );
+    }
+
+    std::shared_ptr<T const> to_shared() nsvp_refref_qual
+    {
+        if ( ! has_value() )
+            return std::shared_ptr<T const>();
+
+        deleter_type deleter( std::move( get_deleter() ) );
+        return std::shared_ptr<T>( release(), std::move( deleter ) );
+    }
+
+#endif
+
 private:
     detail::compressed_ptr<T, Cloner, Deleter> ptr;
 };
@@ -1113,6 +2210,33 @@ inline bool operator>=( std::nullptr_t, value_ptr<T, D, C> const & rhs )
 
 #endif // nsvp_HAVE_NULLPTR
 
+#if nsvp_HAVE_THREE_WAY_COMPARISON
+
+// three-way comparison of pointers (C++20):
+
+template<
+    class T1, class D1, class C1,
+    class T2, class D2, class C2
+>
+inline std::strong_ordering operator<=>(
+    value_ptr<T1, D1, C1> const & lhs,
+    value_ptr<T2, D2, C2> const & rhs )
+{
+    using P1 = typename value_ptr<T1, D1, C1>::const_pointer;
+    using P2 = typename value_ptr<T2, D2, C2>::const_pointer;
+    using CT = typename std::common_type<P1, P2>::type;
+    return std::compare_three_way()( static_cast<CT>( lhs.get() ), static_cast<CT>( rhs.get() ) );
+}
+
+template< class T, class D, class C >
+inline std::strong_ordering operator<=>( value_ptr<T, D, C> const & lhs, std::nullptr_t )
+{
+    using P = typename value_ptr<T, D, C>::const_pointer;
+    return std::compare_three_way()( static_cast<P>( lhs.get() ), static_cast<P>( nullptr ) );
+}
+
+#endif // nsvp_HAVE_THREE_WAY_COMPARISON
+
 #else  // nsvp_CONFIG_COMPARE_POINTERS
 
 // compare content:
@@ -1266,6 +2390,93 @@ bool operator>=( T const & value, value_ptr<T,C,D> const & vp )
     return bool(vp) ? value >= *vp : true;
 }
 
+// compare with std::nullptr_t, for equality only:
+
+#if nsvp_HAVE_NULLPTR
+
+template< class T, class C, class D >
+inline bool operator==( value_ptr<T,C,D> const & vp, std::nullptr_t ) nsvp_noexcept
+{
+    return ! vp;
+}
+
+template< class T, class C, class D >
+inline bool operator==( std::nullptr_t, value_ptr<T,C,D> const & vp ) nsvp_noexcept
+{
+    return ! vp;
+}
+
+template< class T, class C, class D >
+inline bool operator!=( value_ptr<T,C,D> const & vp, std::nullptr_t ) nsvp_noexcept
+{
+    return static_cast<bool>( vp );
+}
+
+template< class T, class C, class D >
+inline bool operator!=( std::nullptr_t, value_ptr<T,C,D> const & vp ) nsvp_noexcept
+{
+    return static_cast<bool>( vp );
+}
+
+#endif // nsvp_HAVE_NULLPTR
+
+#if nsvp_HAVE_THREE_WAY_COMPARISON
+
+// three-way comparison of content (C++20), an empty value_ptr orders first.
+// Reversed operands are provided by the language via rewritten candidates:
+
+namespace detail {
+
+// synthesized three-way comparison, via operator<=> if available, else via operator<:
+
+struct synth_three_way
+{
+    template< class A, class B >
+    constexpr auto operator()( A const & a, B const & b ) const
+    {
+        if constexpr ( std::three_way_comparable_with<A, B> )
+        {
+            return a <=> b;
+        }
+        else
+        {
+            return a < b ? std::weak_ordering::less
+                 : b < a ? std::weak_ordering::greater
+                         : std::weak_ordering::equivalent;
+        }
+    }
+};
+
+template< class A, class B >
+using synth_three_way_result = decltype( synth_three_way()( std::declval<A const &>(), std::declval<B const &>() ) );
+
+} // namespace detail
+
+template<
+    class T1, class D1, class C1,
+    class T2, class D2, class C2
+>
+inline detail::synth_three_way_result<T1, T2> operator<=>(
+    value_ptr<T1, D1, C1> const & lhs,
+    value_ptr<T2, D2, C2> const & rhs )
+{
+    return ( lhs && rhs ) ? detail::synth_three_way()( *lhs, *rhs ) : bool(lhs) <=> bool(rhs);
+}
+
+template< class T, class C, class D >
+inline detail::synth_three_way_result<T, T> operator<=>( value_ptr<T,C,D> const & vp, T const & value )
+{
+    return bool(vp) ? detail::synth_three_way()( *vp, value ) : std::strong_ordering::less;
+}
+
+template< class T, class C, class D >
+inline std::strong_ordering operator<=>( value_ptr<T,C,D> const & vp, std::nullptr_t ) nsvp_noexcept
+{
+    return bool(vp) <=> false;
+}
+
+#endif // nsvp_HAVE_THREE_WAY_COMPARISON
+
 #endif // nsvp_CONFIG_COMPARE_POINTERS
 
 // swap:
@@ -1278,6 +2489,78 @@ inline void swap(
     lhs.swap( rhs );
 }
 
+#if nsvp_CPP11_OR_GREATER
+
+// Transparent function objects for heterogeneous lookup, so that containers
+// keyed by value_ptr can be searched with a T const & or a T * without
+// constructing a value_ptr. These always compare and hash the content:
+
+namespace detail {
+
+template< class T, class C, class D >
+inline T const * content_of( value_ptr<T, C, D> const & vp ) nsvp_noexcept
+{
+    return vp.get();
+}
+
+template< class T >
+inline T const * content_of( T const & value ) nsvp_noexcept
+{
+    return &value;
+}
+
+template< class T >
+inline T const * content_of( T * ptr ) nsvp_noexcept
+{
+    return ptr;
+}
+
+} // namespace detail
+
+// orders as the content comparison operators, empty before any value:
+
+struct value_ptr_less
+{
+    typedef void is_transparent;
+
+    template< class A, class B >
+    bool operator()( A const & a, B const & b ) const
+    {
+        auto pa = detail::content_of( a );
+        auto pb = detail::content_of( b );
+        return pb && ( !pa || *pa < *pb );
+    }
+};
+
+struct value_ptr_equal_to
+{
+    typedef void is_transparent;
+
+    template< class A, class B >
+    bool operator()( A const & a, B const & b ) const
+    {
+        auto pa = detail::content_of( a );
+        auto pb = detail::content_of( b );
+        return ( pa && pb ) ? *pa == *pb : bool(pa) == bool(pb);
+    }
+};
+
+// consistent with std::hash<value_ptr> in content comparison mode:
+
+struct value_ptr_hash
+{
+    typedef void is_transparent;
+
+    template< class A >
+    std::size_t operator()( A const & a ) const
+    {
+        return detail::hash_content( detail::content_of( a ) );
+    }
+};
+
+#endif // nsvp_CPP11_OR_GREATER
+
+
 } // namespace vptr
 
 using namespace vptr;
@@ -1299,7 +2582,11 @@ struct hash< nonstd::value_ptr<T, D, C> >
 
     result_type operator()( argument_type const & p ) const nsvp_noexcept
     {
+#if nsvp_CONFIG_COMPARE_POINTERS
         return hash<typename argument_type::const_pointer>()( p.get() );
+#else
+        return nonstd::vptr::detail::hash_content( p.get() );
+#endif
     }
 };
 
@@ -0,0 +1,532 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: clone_context and memo_clone, locality_clone.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_CLONE_LITE_HPP
+#define NONSTD_VALUE_PTR_CLONE_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstddef>
+# include <cstring>
+# include <new>
+# include <unordered_map>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+namespace detail {
+
+// objects of memo_clone<T> carry a reference count in a header in front of
+// them, so that the links of a copy can share a node the way the links of
+// the source do:
+
+struct memo_header
+{
+    std::atomic<std::size_t> refs;
+
+    memo_header() nsvp_noexcept
+    : refs( 1 )
+    {}
+};
+
+template< class T >
+struct memo_object
+{
+    static std::size_t const offset = ( sizeof( memo_header ) + alignof( T ) - 1 ) / alignof( T ) * alignof( T );
+
+    static memo_header * header_of( T const * ptr ) nsvp_noexcept
+    {
+        return reinterpret_cast<memo_header *>( const_cast<char *>( reinterpret_cast<char const *>( ptr ) ) - offset );
+    }
+
+    // releases the memory if construction throws:
+
+    struct guard
+    {
+        void * mem;
+        ~guard() { if ( mem ) ::operator delete( mem ); }
+    };
+
+    template< class... Args >
+    static T * create( Args&&... args )
+    {
+        nsvp_static_assert( alignof( T ) <= alignof( std::max_align_t ), "memo_clone does not support over-aligned types" );
+
+        guard g = { ::operator new( offset + sizeof( T ) ) };
+        T * result = ::new( static_cast<char *>( g.mem ) + offset ) T( std::forward<Args>(args)...);
+        ::new( g.mem ) memo_header();
+        g.mem = nullptr;
+        return result;
+    }
+
+    static void acquire( T const * ptr ) nsvp_noexcept
+    {
+        header_of( ptr )->refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    static void release( T * ptr ) nsvp_noexcept
+    {
+        memo_header * header = header_of( ptr );
+
+        if ( header->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+            return;
+
+        ptr->~T();
+        header->~memo_header();
+        ::operator delete( header );
+    }
+
+    static void release_void( void * ptr ) nsvp_noexcept
+    {
+        release( static_cast<T *>( ptr ) );
+    }
+};
+
+} // namespace detail
+
+// clone context, a memo from source object to clone, consulted by memo_clone<>
+// while a clone_with() operation is in progress on the current thread. The
+// memo is keyed by address and type, as a member may share the address of the
+// object it is part of. A source may be freed or modified once the operation
+// is over, so the memo is cleared when the outermost scope of the context
+// ends, i.e. when clone_with() returns. To share clones among several copies,
+// make them within one scope:
+//
+//     clone_context::scope session( ctx );
+//     a->left  = shared;
+//     a->right = shared;    // same clone as a->left
+
+class clone_context
+{
+public:
+    clone_context()
+    : memo_()
+    , depth_( 0 )
+    {}
+
+    ~clone_context()
+    {
+        clear();
+    }
+
+    clone_context( clone_context const & ) = delete;
+    clone_context & operator=( clone_context const & ) = delete;
+
+    template< class T >
+    T * find( T const * source ) const
+    {
+        typename memo_type::const_iterator pos = memo_.find( key_of( source ) );
+
+        return pos != memo_.end() ? static_cast<T *>( pos->second.clone ) : nullptr;
+    }
+
+    // remember clone, an object created by memo_clone<T>, as the clone of source:
+
+    template< class T >
+    void insert( T const * source, T * clone )
+    {
+        entry_type & entry = memo_[ key_of( source ) ];
+
+        detail::memo_object<T>::acquire( clone );
+
+        if ( entry.clone )
+            entry.release( entry.clone );
+
+        entry.clone   = clone;
+        entry.release = &detail::memo_object<T>::release_void;
+    }
+
+    std::size_t size() const nsvp_noexcept
+    {
+        return memo_.size();
+    }
+
+    void clear() nsvp_noexcept
+    {
+        for ( typename memo_type::iterator pos = memo_.begin(); pos != memo_.end(); ++pos )
+            pos->second.release( pos->second.clone );
+
+        memo_.clear();
+    }
+
+    static clone_context * current() nsvp_noexcept
+    {
+        return current_ref();
+    }
+
+    // make a context current for the lifetime of the scope, and clear its
+    // memo at the end of the outermost one:
+
+    class scope
+    {
+    public:
+        explicit scope( clone_context & ctx ) nsvp_noexcept
+        : ctx_( ctx )
+        , prev_( current_ref() )
+        {
+            ++ctx_.depth_;
+            current_ref() = &ctx;
+        }
+
+        ~scope()
+        {
+            current_ref() = prev_;
+
+            if ( --ctx_.depth_ == 0 )
+                ctx_.clear();
+        }
+
+        scope( scope const & ) = delete;
+        scope & operator=( scope const & ) = delete;
+
+    private:
+        clone_context & ctx_;
+        clone_context * prev_;
+    };
+
+private:
+    template< class T >
+    struct type_tag
+    {
+        static char id;
+    };
+
+    typedef std::pair< void const *, char const * > key_type;
+
+    struct key_hash
+    {
+        std::size_t operator()( key_type const & key ) const nsvp_noexcept
+        {
+            std::size_t const h = std::hash<void const *>()( key.first );
+            return h ^ ( std::hash<void const *>()( key.second ) + 0x9e3779b9 + ( h << 6 ) + ( h >> 2 ) );
+        }
+    };
+
+    struct entry_type
+    {
+        void * clone;
+        void (*release)( void * );
+    };
+
+    typedef std::unordered_map< key_type, entry_type, key_hash > memo_type;
+
+    template< class T >
+    static key_type key_of( T const * source ) nsvp_noexcept
+    {
+        return key_type( source, &type_tag<T>::id );
+    }
+
+    static clone_context * & current_ref() nsvp_noexcept
+    {
+        static thread_local clone_context * ctx = nullptr;
+        return ctx;
+    }
+
+    memo_type memo_;
+    unsigned depth_;
+};
+
+template< class T >
+char clone_context::type_tag<T>::id = 0;
+
+// deleter that drops a reference to an object created by memo_clone<T>,
+// destroying it with the last one:
+
+template< class T >
+struct memo_delete
+{
+    void operator()( T * ptr ) const nsvp_noexcept
+    {
+        if ( ptr )
+            detail::memo_object<T>::release( ptr );
+    }
+};
+
+// cloner that clones a source object only once per clone_with() operation or
+// clone_context::scope. A memo hit yields an already produced clone with its
+// reference count raised, so the links of the copy share it the way the links
+// of the source do. Use it together with memo_delete<T>, and adopt only
+// pointers that come from memo_clone<T>:
+
+template< class T >
+struct memo_clone
+{
+    T * operator()( T const & x ) const
+    {
+        clone_context * ctx = clone_context::current();
+
+        if ( ! ctx )
+            return detail::memo_object<T>::create( x );
+
+        if ( T * known = ctx->find( &x ) )
+        {
+            detail::memo_object<T>::acquire( known );
+            return known;
+        }
+
+        std::unique_ptr< T, memo_delete<T> > clone( detail::memo_object<T>::create( x ) );
+        ctx->insert( &x, clone.get() );
+        return clone.release();
+    }
+
+    T * operator()( T && x ) const
+    {
+        return detail::memo_object<T>::create( std::move( x ) );
+    }
+
+    template< class... Args >
+    T * operator()( nonstd_lite_in_place_t(T), Args&&... args ) const
+    {
+        return detail::memo_object<T>::create( std::forward<Args>(args)...);
+    }
+
+    template< class U, class... Args >
+    T * operator()( nonstd_lite_in_place_t(T), std::initializer_list<U> il, Args&&... args ) const
+    {
+        return detail::memo_object<T>::create( il, std::forward<Args>(args)...);
+    }
+};
+
+template< class T >
+using memo_value_ptr = value_ptr< T, memo_clone<T>, memo_delete<T> >;
+
+// Locality-aware cloning, clones placed next to the object that owns them:
+
+namespace detail {
+
+// region of memory handed out by bumping a pointer, freed when its last
+// object is deleted and no arena holds on to it anymore. Only the owning
+// thread allocates, any thread may release:
+
+class locality_region
+{
+public:
+    static std::size_t const align = alignof( std::max_align_t );
+
+    static std::size_t round_up( std::size_t size ) nsvp_noexcept
+    {
+        return ( size + align - 1 ) / align * align;
+    }
+
+    static locality_region * create( std::size_t size )
+    {
+        void * mem = ::operator new( round_up( sizeof( locality_region ) ) + size );
+        return ::new( mem ) locality_region( size );
+    }
+
+    bool contains( void const * ptr ) const nsvp_noexcept
+    {
+        std::less<char const *> less;
+        char const * p = static_cast<char const *>( ptr );
+
+        return ! less( p, begin_ ) && less( p, end_ );
+    }
+
+    void * allocate( std::size_t size ) nsvp_noexcept
+    {
+        if ( static_cast<std::size_t>( end_ - next_ ) < size )
+            return nullptr;
+
+        void * result = next_;
+        next_ += size;
+        refs_.fetch_add( 1, std::memory_order_relaxed );
+        return result;
+    }
+
+    void release() nsvp_noexcept
+    {
+        if ( refs_.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        {
+            this->~locality_region();
+            ::operator delete( this );
+        }
+    }
+
+private:
+    explicit locality_region( std::size_t size ) nsvp_noexcept
+    : refs_ ( 1 )
+    , begin_( reinterpret_cast<char *>( this ) + round_up( sizeof( locality_region ) ) )
+    , next_ ( begin_ )
+    , end_  ( begin_ + size )
+    {}
+
+    std::atomic<std::size_t> refs_;
+    char * begin_;
+    char * next_;
+    char * end_;
+};
+
+// per-thread set of the most recently opened regions; an object is placed in
+// the region that contains its hint if possible, else in the newest region.
+// Each object is preceded by a header that refers to its region:
+
+class locality_arena
+{
+public:
+    static std::size_t const region_size = 64 * 1024;
+    static std::size_t const max_open    = 8;
+    static std::size_t const header_size = locality_region::align;
+
+    locality_arena() nsvp_noexcept
+    : count_( 0 )
+    {}
+
+    ~locality_arena()
+    {
+        for ( std::size_t i = 0; i != count_; ++i )
+            open_[i]->release();
+    }
+
+    locality_arena( locality_arena const & ) = delete;
+    locality_arena & operator=( locality_arena const & ) = delete;
+
+    void * allocate( std::size_t size, void const * hint )
+    {
+        std::size_t const slot = header_size + locality_region::round_up( size );
+
+        if ( slot > region_size / 4 )
+        {
+            locality_region * region = locality_region::create( slot );
+            void * mem = region->allocate( slot );
+            region->release();
+            return with_header( mem, region );
+        }
+
+        for ( std::size_t i = 0; hint && i != count_; ++i )
+        {
+            if ( open_[i]->contains( hint ) )
+            {
+                if ( void * mem = open_[i]->allocate( slot ) )
+                    return with_header( mem, open_[i] );
+                break;
+            }
+        }
+
+        if ( count_ > 0 )
+        {
+            if ( void * mem = open_[count_ - 1]->allocate( slot ) )
+                return with_header( mem, open_[count_ - 1] );
+        }
+
+        locality_region & region = open();
+        return with_header( region.allocate( slot ), &region );
+    }
+
+    static void deallocate( void * ptr ) nsvp_noexcept
+    {
+        region_of( ptr )->release();
+    }
+
+    static locality_arena & current()
+    {
+        static thread_local locality_arena arena;
+        return arena;
+    }
+
+private:
+    locality_region & open()
+    {
+        locality_region * region = locality_region::create( region_size );
+
+        if ( count_ == max_open )
+        {
+            open_[0]->release();
+            std::memmove( open_, open_ + 1, ( max_open - 1 ) * sizeof( open_[0] ) );
+            --count_;
+        }
+        return *( open_[count_++] = region );
+    }
+
+    static void * with_header( void * mem, locality_region * region ) nsvp_noexcept
+    {
+        *static_cast<locality_region **>( mem ) = region;
+        return static_cast<char *>( mem ) + header_size;
+    }
+
+    static locality_region * region_of( void * ptr ) nsvp_noexcept
+    {
+        return *reinterpret_cast<locality_region **>( static_cast<char *>( ptr ) - header_size );
+    }
+
+    locality_region * open_[ max_open ];
+    std::size_t count_;
+};
+
+} // namespace detail
+
+// cloner that allocates from a per-thread bump region near the placement
+// hint, the owning object, so that deep copies of trees come out clustered.
+// Use together with locality_delete<T>:
+
+template< class T >
+struct locality_clone
+{
+    T * operator()( T const & x, void const * hint = nullptr ) const
+    {
+        return create( x, hint );
+    }
+
+    T * operator()( T && x, void const * hint = nullptr ) const
+    {
+        return create( std::move( x ), hint );
+    }
+
+private:
+    // releases the memory if construction throws:
+
+    struct guard
+    {
+        void * mem;
+        ~guard() { if ( mem ) detail::locality_arena::deallocate( mem ); }
+    };
+
+    template< class V >
+    static T * create( V && x, void const * hint )
+    {
+        nsvp_static_assert( alignof( T ) <= detail::locality_region::align, "locality_clone does not support over-aligned types" );
+
+        guard g = { detail::locality_arena::current().allocate( sizeof( T ), hint ) };
+        T * result = ::new( g.mem ) T( std::forward<V>( x ) );
+        g.mem = nullptr;
+        return result;
+    }
+};
+
+template< class T >
+struct locality_delete
+{
+    void operator()( T * ptr ) const nsvp_noexcept
+    {
+        if ( ! ptr )
+            return;
+
+        ptr->~T();
+        detail::locality_arena::deallocate( ptr );
+    }
+};
+
+template< class T >
+using locality_value_ptr = value_ptr< T, locality_clone<T>, locality_delete<T> >;
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_CLONE_LITE_HPP
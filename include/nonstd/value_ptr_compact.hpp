@@ -0,0 +1,593 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: compact_value_ptr and compact_pool.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_COMPACT_LITE_HPP
+#define NONSTD_VALUE_PTR_COMPACT_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstddef>
+# include <cstdint>
+# include <cstring>
+# include <mutex>
+# include <new>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Compact handles, a 32-bit index into a typed pool instead of a pointer:
+
+namespace detail {
+
+// index of the most significant set bit, value must be non-zero:
+
+inline unsigned floor_log2( std::uint64_t value ) nsvp_noexcept
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return 63u - static_cast<unsigned>( __builtin_clzll( value ) );
+#else
+    unsigned result = 0;
+    for ( unsigned shift = 32; shift > 0; shift /= 2 )
+    {
+        if ( value >> shift )
+        {
+            value >>= shift;
+            result += shift;
+        }
+    }
+    return result;
+#endif
+}
+
+} // namespace detail
+
+// Pool of objects of type T, addressed by a 32-bit index; index 0 denotes no
+// object. Storage grows in chunks of doubling size that are never moved, so
+// that get() is lock-free. Each thread keeps a free list of its own, creation
+// and destruction lock the shared free list only to move a batch of indices.
+// A thread returns its free list when it exits, or on flush().
+//
+// Chunks are not released while the program runs: a handle is an index into
+// them that may outlive any pool state, so released slots are only reused.
+// The chunks are reclaimed at program exit; a pool is never destroyed:
+
+template< class T >
+class compact_pool
+{
+public:
+    typedef std::uint32_t index_type;
+
+    template< class... Args >
+    static index_type create( Args&&... args )
+    {
+        compact_pool & pool = instance();
+        index_type const index = pool.acquire();
+
+        struct release_guard
+        {
+            compact_pool * pool; index_type index;
+            ~release_guard() { if ( index ) pool->release( index ); }
+        } guard = { &pool, index };
+
+        ::new( static_cast<void *>( pool.slot_of( index ) ) ) T( std::forward<Args>(args)...);
+
+        guard.index = 0;
+        return index;
+    }
+
+    static void destroy( index_type index ) nsvp_noexcept
+    {
+        if ( index == 0 )
+            return;
+
+        compact_pool & pool = instance();
+
+        get( index )->~T();
+        pool.release( index );
+    }
+
+    static T * get( index_type index ) nsvp_noexcept
+    {
+        return index ? reinterpret_cast<T *>( instance().slot_of( index ) ) : nullptr;
+    }
+
+    // number of live objects:
+
+    static std::size_t live() nsvp_noexcept
+    {
+        return instance().live_.load( std::memory_order_relaxed );
+    }
+
+    // return the free indices kept by the calling thread to the shared list:
+
+    static void flush() nsvp_noexcept
+    {
+        cache & c = local();
+
+        if ( c.count != 0 )
+        {
+            compact_pool & pool = instance();
+            std::lock_guard<std::mutex> lock( pool.mutex_ );
+            pool.give_back( c, c.count );
+        }
+    }
+
+private:
+    struct slot
+    {
+        alignas( T ) unsigned char bytes[ sizeof(T) < sizeof(index_type) ? sizeof(index_type) : sizeof(T) ];
+    };
+
+    nsvp_static_assert( alignof( T ) <= alignof( std::max_align_t ), "compact_pool does not support over-aligned types" );
+
+    // chunk k holds first_chunk << k slots, slot s = index - 1:
+
+    static unsigned const first_chunk_log2 = 10;
+    static unsigned const max_chunks = 33 - first_chunk_log2;
+
+    // indices moved between a thread's free list and the shared one at once:
+
+    static unsigned const batch = 64;
+
+    // the free list of a thread is trivially destructible, so that it stays
+    // usable in destructors of other thread_local objects; flusher hands it
+    // back at thread exit and then marks it dead, after which the thread uses
+    // the shared list. Both acquire() and release() register the flusher, so
+    // that a thread that only releases does not take its list along:
+
+    struct cache
+    {
+        index_type head;
+        unsigned count;
+        bool dead;
+    };
+
+    struct flusher
+    {
+        ~flusher()
+        {
+            flush();
+            local().dead = true;
+        }
+    };
+
+    static cache & local() nsvp_noexcept
+    {
+        static thread_local cache c = { 0, 0, false };
+        return c;
+    }
+
+    static void register_flusher()
+    {
+        static thread_local flusher f;
+        (void) f;
+    }
+
+    compact_pool() nsvp_noexcept
+    : next_( 1 )
+    , free_( 0 )
+    , live_( 0 )
+    {
+        for ( unsigned k = 0; k < max_chunks; ++k )
+            chunks_[k].store( nullptr, std::memory_order_relaxed );
+    }
+
+    // never destroyed, so that pooled objects of static duration outlive it:
+
+    static compact_pool & instance()
+    {
+        static compact_pool * pool = new compact_pool();
+        return *pool;
+    }
+
+    static unsigned chunk_of( std::uint64_t u ) nsvp_noexcept
+    {
+        return detail::floor_log2( u ) - first_chunk_log2;
+    }
+
+    slot * slot_of( index_type index ) const nsvp_noexcept
+    {
+        std::uint64_t const u = std::uint64_t( index - 1 ) + ( std::uint64_t(1) << first_chunk_log2 );
+        unsigned const k = chunk_of( u );
+
+        return chunks_[k].load( std::memory_order_acquire ) + ( u - ( std::uint64_t(1) << ( k + first_chunk_log2 ) ) );
+    }
+
+    index_type next_of( index_type index ) const nsvp_noexcept
+    {
+        index_type next;
+        std::memcpy( &next, slot_of( index )->bytes, sizeof next );
+        return next;
+    }
+
+    void set_next( index_type index, index_type next ) nsvp_noexcept
+    {
+        std::memcpy( slot_of( index )->bytes, &next, sizeof next );
+    }
+
+    bool has_slot( index_type index ) const nsvp_noexcept
+    {
+        std::uint64_t const u = std::uint64_t( index - 1 ) + ( std::uint64_t(1) << first_chunk_log2 );
+        return chunks_[ chunk_of( u ) ].load( std::memory_order_relaxed ) != nullptr;
+    }
+
+    index_type acquire()
+    {
+        cache & c = local();
+
+        if ( c.head == 0 )
+        {
+            if ( c.dead )
+            {
+                std::lock_guard<std::mutex> lock( mutex_ );
+                index_type const index = take_shared();
+                live_.fetch_add( 1, std::memory_order_relaxed );
+                return index;
+            }
+
+            register_flusher();
+            refill( c );
+        }
+
+        index_type const index = c.head;
+        c.head = next_of( index );
+        --c.count;
+
+        live_.fetch_add( 1, std::memory_order_relaxed );
+        return index;
+    }
+
+    void release( index_type index ) nsvp_noexcept
+    {
+        cache & c = local();
+
+        live_.fetch_sub( 1, std::memory_order_relaxed );
+
+        if ( c.dead )
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            set_next( index, free_ );
+            free_ = index;
+            return;
+        }
+
+        register_flusher();
+        set_next( index, c.head );
+        c.head = index;
+
+        if ( ++c.count > 2 * batch )
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            give_back( c, batch );
+        }
+    }
+
+    // move up to batch indices to the thread's free list; only the first may
+    // allocate a chunk, so that a failure leaves the pool unchanged:
+
+    void refill( cache & c )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        index_type index = take_shared();
+
+        for ( unsigned n = 0; ; )
+        {
+            set_next( index, c.head );
+            c.head = index;
+            ++c.count;
+
+            if ( ++n == batch )
+                break;
+
+            if ( free_ != 0 )
+            {
+                index = free_;
+                free_ = next_of( index );
+            }
+            else if ( next_ != 0 && has_slot( next_ ) )
+            {
+                index = next_++;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    // take one index from the shared list, or a new one; requires the lock:
+
+    index_type take_shared()
+    {
+        index_type index = free_;
+
+        if ( index != 0 )
+        {
+            free_ = next_of( index );
+            return index;
+        }
+
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( next_ != 0 && "compact_pool exhausted" );
+#else
+        if ( next_ == 0 )
+            throw std::bad_alloc();
+#endif
+
+        std::uint64_t const u = std::uint64_t( next_ - 1 ) + ( std::uint64_t(1) << first_chunk_log2 );
+        unsigned const k = chunk_of( u );
+
+        if ( chunks_[k].load( std::memory_order_relaxed ) == nullptr )
+        {
+            std::size_t const count = std::size_t(1) << ( k + first_chunk_log2 );
+            chunks_[k].store( static_cast<slot *>( ::operator new( count * sizeof(slot) ) ), std::memory_order_release );
+        }
+
+        return next_++;
+    }
+
+    // move count indices of the thread's free list to the shared list;
+    // requires the lock:
+
+    void give_back( cache & c, unsigned count ) nsvp_noexcept
+    {
+        for ( ; count > 0 && c.head != 0; --count )
+        {
+            index_type const index = c.head;
+            c.head = next_of( index );
+            --c.count;
+
+            set_next( index, free_ );
+            free_ = index;
+        }
+    }
+
+    std::mutex mutex_;
+    std::atomic<slot *> chunks_[ max_chunks ];
+    index_type next_;
+    index_type free_;
+    std::atomic<std::size_t> live_;
+};
+
+// value_ptr-like handle of 32 bits with value semantics: copying clones the
+// content into the pool, destruction destroys it. Pool provides the static
+// create( args... ), destroy( index ) and get( index ) of compact_pool:
+
+template
+<
+    class T
+    , class Pool = compact_pool<T>
+>
+class compact_value_ptr
+{
+public:
+    typedef typename Pool::index_type index_type;
+
+    typedef T         element_type;
+    typedef T *       pointer;
+    typedef T &       reference;
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    // Lifetime
+
+    compact_value_ptr() nsvp_noexcept
+    : index_( 0 )
+    {}
+
+    compact_value_ptr( std::nullptr_t ) nsvp_noexcept
+    : index_( 0 )
+    {}
+
+    compact_value_ptr( element_type const & value )
+    : index_( Pool::create( value ) )
+    {}
+
+    compact_value_ptr( element_type && value )
+    : index_( Pool::create( std::move( value ) ) )
+    {}
+
+    template< class... Args
+        nsvp_REQUIRES_T(
+            std::is_constructible<T, Args&&...>::value )
+    >
+    explicit compact_value_ptr( nonstd_lite_in_place_t(T), Args&&... args )
+    : index_( Pool::create( std::forward<Args>(args)...) )
+    {}
+
+    compact_value_ptr( compact_value_ptr const & other )
+    : index_( other ? Pool::create( *other ) : 0 )
+    {}
+
+    compact_value_ptr( compact_value_ptr && other ) nsvp_noexcept
+    : index_( other.index_ )
+    {
+        other.index_ = 0;
+    }
+
+    ~compact_value_ptr()
+    {
+        Pool::destroy( index_ );
+    }
+
+    compact_value_ptr & operator=( compact_value_ptr const & rhs )
+    {
+        compact_value_ptr( rhs ).swap( *this );
+        return *this;
+    }
+
+    compact_value_ptr & operator=( compact_value_ptr && rhs ) nsvp_noexcept
+    {
+        compact_value_ptr( std::move( rhs ) ).swap( *this );
+        return *this;
+    }
+
+    compact_value_ptr & operator=( std::nullptr_t ) nsvp_noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template< class U
+        nsvp_REQUIRES_T(
+            std::is_same< typename std::decay<U>::type, T>::value )
+    >
+    compact_value_ptr & operator=( U && value )
+    {
+        if ( index_ )
+            *get() = std::forward<U>( value );
+        else
+            index_ = Pool::create( std::forward<U>( value ) );
+        return *this;
+    }
+
+    template< class... Args >
+    void emplace( Args&&... args )
+    {
+        reset();
+        index_ = Pool::create( std::forward<Args>(args)...);
+    }
+
+    // Observers:
+
+    pointer get() const nsvp_noexcept
+    {
+        return Pool::get( index_ );
+    }
+
+    reference operator*() const
+    {
+        assert( index_ != 0 ); return *get();
+    }
+
+    pointer operator->() const nsvp_noexcept
+    {
+        assert( index_ != 0 ); return get();
+    }
+
+    const_reference value() const
+    {
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( has_value() );
+#else
+        if ( ! has_value() )
+        {
+            throw bad_value_access();
+        }
+#endif
+        return *get();
+    }
+
+    reference value()
+    {
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( has_value() );
+#else
+        if ( ! has_value() )
+        {
+            throw bad_value_access();
+        }
+#endif
+        return *get();
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return has_value();
+    }
+
+    bool has_value() const nsvp_noexcept
+    {
+        return index_ != 0;
+    }
+
+    index_type index() const nsvp_noexcept
+    {
+        return index_;
+    }
+
+    // Modifiers:
+
+    void reset() nsvp_noexcept
+    {
+        index_type const index = index_;
+        index_ = 0;
+        Pool::destroy( index );
+    }
+
+    void swap( compact_value_ptr & other ) nsvp_noexcept
+    {
+        std::swap( index_, other.index_ );
+    }
+
+private:
+    index_type index_;
+};
+
+// compare content, an empty compact_value_ptr orders before any value:
+
+template< class T, class P >
+inline bool operator==( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return bool(lhs) != bool(rhs) ? false : bool(lhs) == false ? true : *lhs == *rhs;
+}
+
+template< class T, class P >
+inline bool operator!=( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return ! ( lhs == rhs );
+}
+
+template< class T, class P >
+inline bool operator<( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return bool(rhs) && ( ! bool(lhs) || *lhs < *rhs );
+}
+
+template< class T, class P >
+inline bool operator<=( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return ! ( rhs < lhs );
+}
+
+template< class T, class P >
+inline bool operator>( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return rhs < lhs;
+}
+
+template< class T, class P >
+inline bool operator>=( compact_value_ptr<T, P> const & lhs, compact_value_ptr<T, P> const & rhs )
+{
+    return ! ( lhs < rhs );
+}
+
+template< class T, class P >
+inline void swap( compact_value_ptr<T, P> & lhs, compact_value_ptr<T, P> & rhs ) nsvp_noexcept
+{
+    lhs.swap( rhs );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_COMPACT_LITE_HPP
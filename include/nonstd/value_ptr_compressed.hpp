@@ -0,0 +1,502 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: compressed_value_ptr.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_COMPRESSED_LITE_HPP
+#define NONSTD_VALUE_PTR_COMPRESSED_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstdint>
+# include <cstring>
+# include <vector>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+
+// Compressed storage, for rarely accessed content:
+
+namespace detail {
+
+// Byte-oriented LZ77 codec in the manner of LZ4. A block is a sequence of
+// runs: a token with the literal length in the high and the match length
+// minus 4 in the low nibble, a nibble of 15 being continued by bytes that are
+// added up to a byte below 255; the literals; a 2-byte little-endian offset
+// and the match. The last run has literals only.
+
+class lz_codec
+{
+public:
+    static void compress( unsigned char const * src, std::size_t size, std::vector<unsigned char> & out )
+    {
+        std::vector<std::uint32_t> table( table_size, 0 );   // position + 1
+        std::size_t pos = 0;
+        std::size_t anchor = 0;
+
+        while ( pos + min_match <= size )
+        {
+            std::uint32_t & entry = table[ hash( src + pos ) ];
+            std::size_t const candidate = entry;
+            entry = static_cast<std::uint32_t>( pos + 1 );
+
+            if ( candidate == 0 || pos + 1 - candidate > max_offset || std::memcmp( src + candidate - 1, src + pos, min_match ) != 0 )
+            {
+                ++pos;
+                continue;
+            }
+
+            std::size_t const match = candidate - 1;
+            std::size_t length = min_match;
+
+            while ( pos + length < size && src[ match + length ] == src[ pos + length ] )
+                ++length;
+
+            emit( src + anchor, pos - anchor, pos - match, length, out );
+
+            pos   += length;
+            anchor = pos;
+        }
+
+        emit( src + anchor, size - anchor, 0, 0, out );
+    }
+
+    static bool decompress( unsigned char const * src, std::size_t size, unsigned char * dst, std::size_t capacity ) nsvp_noexcept
+    {
+        unsigned char const * const end = src + size;
+        std::size_t out = 0;
+
+        while ( src != end )
+        {
+            unsigned const token = *src++;
+            std::size_t literals = token >> 4;
+
+            if ( ! extend( literals, src, end ) || literals > static_cast<std::size_t>( end - src ) || literals > capacity - out )
+                return false;
+
+            std::memcpy( dst + out, src, literals );
+            src += literals;
+            out += literals;
+
+            if ( src == end )
+                break;
+
+            if ( end - src < 2 )
+                return false;
+
+            std::size_t const offset = std::size_t( src[0] ) | std::size_t( src[1] ) << 8;
+            std::size_t length = token & 15u;
+            src += 2;
+
+            if ( ! extend( length, src, end ) )
+                return false;
+
+            length += min_match;
+
+            if ( offset == 0 || offset > out || length > capacity - out )
+                return false;
+
+            for ( std::size_t i = 0; i != length; ++i, ++out )   // may overlap
+                dst[ out ] = dst[ out - offset ];
+        }
+        return out == capacity;
+    }
+
+private:
+    static std::size_t const min_match  = 4;
+    static std::size_t const max_offset = 65535;
+    static std::size_t const table_bits = 12;
+    static std::size_t const table_size = std::size_t(1) << table_bits;
+
+    static std::size_t hash( unsigned char const * p ) nsvp_noexcept
+    {
+        std::uint32_t v;
+        std::memcpy( &v, p, sizeof v );
+        return ( v * 2654435761u ) >> ( 32 - table_bits );
+    }
+
+    static void put_length( std::size_t length, std::vector<unsigned char> & out )
+    {
+        for ( ; length >= 255; length -= 255 )
+            out.push_back( 255 );
+        out.push_back( static_cast<unsigned char>( length ) );
+    }
+
+    static bool extend( std::size_t & length, unsigned char const *& src, unsigned char const * end ) nsvp_noexcept
+    {
+        if ( length != 15 )
+            return true;
+
+        for (;;)
+        {
+            if ( src == end )
+                return false;
+
+            unsigned char const byte = *src++;
+            length += byte;
+
+            if ( byte != 255 )
+                return true;
+        }
+    }
+
+    static void emit( unsigned char const * literals, std::size_t count, std::size_t offset, std::size_t length, std::vector<unsigned char> & out )
+    {
+        std::size_t const match = length ? length - min_match : 0;
+
+        out.push_back( static_cast<unsigned char>( ( count < 15 ? count : 15 ) << 4 | ( match < 15 ? match : 15 ) ) );
+
+        if ( count >= 15 )
+            put_length( count - 15, out );
+
+        out.insert( out.end(), literals, literals + count );
+
+        if ( length == 0 )
+            return;
+
+        out.push_back( static_cast<unsigned char>( offset & 0xff ) );
+        out.push_back( static_cast<unsigned char>( offset >> 8 ) );
+
+        if ( match >= 15 )
+            put_length( match - 15, out );
+    }
+};
+
+// per-thread cache of inflated values, evicting round-robin but never the
+// entry accessed last; payloads are identified by a process-wide id, unique
+// per compression:
+
+inline std::uint64_t next_compressed_id() nsvp_noexcept
+{
+    static std::atomic<std::uint64_t> id( 0 );
+    return id.fetch_add( 1, std::memory_order_relaxed ) + 1;
+}
+
+template< class T >
+class inflate_cache
+{
+public:
+    static std::size_t const slots = 4;
+
+    static inflate_cache & current()
+    {
+        static thread_local inflate_cache cache;
+        return cache;
+    }
+
+    T const * find( std::uint64_t id ) nsvp_noexcept
+    {
+        for ( std::size_t i = 0; i != slots; ++i )
+        {
+            if ( ids_[i] == id )
+            {
+                last_ = i;
+                return reinterpret_cast<T const *>( slot_[i].bytes );
+            }
+        }
+        return nullptr;
+    }
+
+    // storage for payload id:
+
+    T * claim( std::uint64_t id ) nsvp_noexcept
+    {
+        if ( next_ == last_ )
+            next_ = ( next_ + 1 ) % slots;
+
+        last_ = next_;
+        next_ = ( next_ + 1 ) % slots;
+        ids_[ last_ ] = id;
+        return reinterpret_cast<T *>( slot_[ last_ ].bytes );
+    }
+
+private:
+    inflate_cache() nsvp_noexcept
+    : next_( 0 )
+    , last_( slots )
+    {
+        for ( std::size_t i = 0; i != slots; ++i )
+            ids_[i] = 0;
+    }
+
+    struct slot
+    {
+        alignas( T ) unsigned char bytes[ sizeof(T) ];
+    };
+
+    slot slot_[ slots ];
+    std::uint64_t ids_[ slots ];
+    std::size_t next_;
+    std::size_t last_;
+};
+
+} // namespace detail
+
+// value_ptr-like holder of a trivially copyable T, kept compressed. Const
+// access inflates the value into a small per-thread cache. A reference
+// obtained from it stays valid across access to one other holder on the same
+// thread, e.g. to compare two values, and until the holder is modified. The
+// content is modified via assignment, emplace() or modify():
+
+template< class T >
+class compressed_value_ptr
+{
+public:
+    nsvp_static_assert( std::is_trivially_copyable<T>::value, "compressed_value_ptr requires a trivially copyable type" );
+
+    typedef T         element_type;
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    // Lifetime
+
+    compressed_value_ptr() nsvp_noexcept
+    : bytes_()
+    , id_( 0 )
+    {}
+
+    compressed_value_ptr( std::nullptr_t ) nsvp_noexcept
+    : bytes_()
+    , id_( 0 )
+    {}
+
+    compressed_value_ptr( element_type const & value )
+    : bytes_()
+    , id_( 0 )
+    {
+        store( value );
+    }
+
+    template< class C, class D >
+    compressed_value_ptr( value_ptr<T, C, D> const & vp )
+    : bytes_()
+    , id_( 0 )
+    {
+        if ( vp )
+            store( *vp );
+    }
+
+    template< class... Args
+        nsvp_REQUIRES_T(
+            std::is_constructible<T, Args&&...>::value )
+    >
+    explicit compressed_value_ptr( nonstd_lite_in_place_t(T), Args&&... args )
+    : bytes_()
+    , id_( 0 )
+    {
+        store( T( std::forward<Args>(args)...) );
+    }
+
+    // copies share the id, as the content is equal:
+
+    compressed_value_ptr( compressed_value_ptr const & other ) = default;
+
+    compressed_value_ptr( compressed_value_ptr && other ) nsvp_noexcept
+    : bytes_( std::move( other.bytes_ ) )
+    , id_( other.id_ )
+    {
+        other.bytes_.clear();
+        other.id_ = 0;
+    }
+
+    compressed_value_ptr & operator=( compressed_value_ptr const & rhs ) = default;
+
+    compressed_value_ptr & operator=( compressed_value_ptr && rhs ) nsvp_noexcept
+    {
+        compressed_value_ptr( std::move( rhs ) ).swap( *this );
+        return *this;
+    }
+
+    compressed_value_ptr & operator=( std::nullptr_t ) nsvp_noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    compressed_value_ptr & operator=( element_type const & value )
+    {
+        store( value );
+        return *this;
+    }
+
+    template< class... Args >
+    void emplace( Args&&... args )
+    {
+        store( T( std::forward<Args>(args)...) );
+    }
+
+    // Observers, via the per-thread cache:
+
+    const_pointer get() const
+    {
+        if ( ! has_value() )
+            return nullptr;
+
+        detail::inflate_cache<T> & cache = detail::inflate_cache<T>::current();
+
+        if ( const_pointer p = cache.find( id_ ) )
+            return p;
+
+        T * p = cache.claim( id_ );
+        inflate( p );
+        return p;
+    }
+
+    const_reference operator*() const
+    {
+        assert( has_value() ); return *get();
+    }
+
+    const_pointer operator->() const
+    {
+        assert( has_value() ); return get();
+    }
+
+    const_reference value() const
+    {
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( has_value() );
+#else
+        if ( ! has_value() )
+        {
+            throw bad_value_access();
+        }
+#endif
+        return *get();
+    }
+
+    // inflated copy of the content, bypassing the cache:
+
+    element_type load() const
+    {
+        struct { alignas( T ) unsigned char bytes[ sizeof(T) ]; } result;
+        inflate( reinterpret_cast<T *>( result.bytes ) );
+        return *reinterpret_cast<T const *>( result.bytes );
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return has_value();
+    }
+
+    bool has_value() const nsvp_noexcept
+    {
+        return ! bytes_.empty();
+    }
+
+    // size of the compressed representation in bytes:
+
+    std::size_t compressed_size() const nsvp_noexcept
+    {
+        return bytes_.size();
+    }
+
+    // Modifiers:
+
+    // apply f to an inflated copy of the content and store the result:
+
+    template< class F >
+    void modify( F && f )
+    {
+        T content = value();
+        std::forward<F>( f )( content );
+        store( content );
+    }
+
+    void reset() nsvp_noexcept
+    {
+        bytes_.clear();
+        bytes_.shrink_to_fit();
+        id_ = 0;
+    }
+
+    void swap( compressed_value_ptr & other ) nsvp_noexcept
+    {
+        bytes_.swap( other.bytes_ );
+        std::swap( id_, other.id_ );
+    }
+
+private:
+    // first byte: 0 raw, 1 compressed, when compression does not pay off:
+
+    enum { raw = 0, lz = 1 };
+
+    void store( T const & value )
+    {
+        unsigned char const * src = reinterpret_cast<unsigned char const *>( &value );
+        std::vector<unsigned char> bytes( 1, static_cast<unsigned char>( lz ) );
+
+        detail::lz_codec::compress( src, sizeof( T ), bytes );
+
+        if ( bytes.size() > sizeof( T ) )
+        {
+            bytes.assign( 1, static_cast<unsigned char>( raw ) );
+            bytes.insert( bytes.end(), src, src + sizeof( T ) );
+        }
+        bytes.shrink_to_fit();
+
+        bytes_.swap( bytes );
+        id_ = detail::next_compressed_id();
+    }
+
+    void inflate( T * target ) const
+    {
+        unsigned char * dst = reinterpret_cast<unsigned char *>( target );
+
+        if ( bytes_[0] == raw )
+        {
+            std::memcpy( dst, bytes_.data() + 1, sizeof( T ) );
+            return;
+        }
+
+        bool const ok = detail::lz_codec::decompress( bytes_.data() + 1, bytes_.size() - 1, dst, sizeof( T ) );
+        assert( ok && "compressed_value_ptr: corrupt payload" ); (void) ok;
+    }
+
+    std::vector<unsigned char> bytes_;
+    std::uint64_t id_;
+};
+
+// compare content:
+
+template< class T >
+inline bool operator==( compressed_value_ptr<T> const & lhs, compressed_value_ptr<T> const & rhs )
+{
+    if ( bool(lhs) != bool(rhs) )
+        return false;
+
+    return ! lhs || *lhs == *rhs;
+}
+
+template< class T >
+inline bool operator!=( compressed_value_ptr<T> const & lhs, compressed_value_ptr<T> const & rhs )
+{
+    return ! ( lhs == rhs );
+}
+
+template< class T >
+inline void swap( compressed_value_ptr<T> & lhs, compressed_value_ptr<T> & rhs ) nsvp_noexcept
+{
+    lhs.swap( rhs );
+}
+
+#endif // nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_COMPRESSED_LITE_HPP
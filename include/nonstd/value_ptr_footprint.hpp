@@ -0,0 +1,190 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: owned_bytes().
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_FOOTPRINT_LITE_HPP
+#define NONSTD_VALUE_PTR_FOOTPRINT_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <string>
+# include <vector>
+#endif
+
+// Size of heap blocks via malloc_usable_size(), glibc:
+
+#ifndef   nsvp_HAVE_MALLOC_USABLE_SIZE
+# if nsvp_CPP11_OR_GREATER && defined( __GLIBC__ )
+#  define nsvp_HAVE_MALLOC_USABLE_SIZE  1
+# else
+#  define nsvp_HAVE_MALLOC_USABLE_SIZE  0
+# endif
+#endif
+
+#if nsvp_HAVE_MALLOC_USABLE_SIZE
+# include <malloc.h>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Memory footprint of a value_ptr and the tree of value_ptr-s below it:
+//
+// owned_bytes( vp ) visits the nodes enumerated via visit_children( node, f ),
+// see compact(), without recursion. Children must be of the same value_ptr
+// type as the root. Memory a node owns beyond its own object, such as the
+// buffer of a std::vector member, is added via an unqualified call
+// owned_payload_bytes( value ), found by argument-dependent lookup; types
+// without it own no further memory. Provided are overloads for std::string
+// and std::vector, which count their buffer only.
+
+struct footprint
+{
+    std::size_t nodes;                  // engaged links
+    std::size_t max_depth;              // nodes on the longest path, 0 if empty
+    std::size_t node_bytes;             // nodes * sizeof( T )
+    std::size_t allocated_bytes;        // size of the nodes' heap blocks, see below
+    std::size_t payload_bytes;          // sum of owned_payload_bytes() of the nodes
+    std::vector<std::size_t> fanout;    // fanout[k]: nodes with k engaged children
+
+    // bytes owned, including allocator overhead of the nodes:
+
+    std::size_t total() const nsvp_noexcept
+    {
+        return allocated_bytes + payload_bytes;
+    }
+};
+
+// heap buffer of a string, none if held in the small-string buffer:
+
+inline std::size_t owned_payload_bytes( std::string const & value ) nsvp_noexcept
+{
+    std::less<char const *> less;
+    char const * const first = reinterpret_cast<char const *>( &value );
+    bool const local = ! less( value.data(), first ) && less( value.data(), first + sizeof value );
+
+    return local ? 0 : value.capacity() + 1;
+}
+
+// buffer of a vector, not what its elements own:
+
+template< class U, class A >
+inline std::size_t owned_payload_bytes( std::vector<U, A> const & value ) nsvp_noexcept
+{
+    return value.capacity() * sizeof( U );
+}
+
+namespace detail {
+
+template< class T >
+inline auto owned_payload_bytes_of( T const & value, int ) -> decltype( std::size_t( owned_payload_bytes( value ) ) )
+{
+    return owned_payload_bytes( value );
+}
+
+template< class T >
+inline std::size_t owned_payload_bytes_of( T const &, long ) nsvp_noexcept
+{
+    return 0;
+}
+
+// true if T, or a base of it, declares its own operator new:
+
+template< class T >
+inline auto has_member_operator_new( int ) -> decltype( T::operator new( std::size_t() ), std::true_type() );
+
+template< class T >
+inline std::false_type has_member_operator_new( long );
+
+// size of the heap block of a node: its usable size if the node is known to
+// come from the global operator new, hence from malloc() on glibc, else an
+// estimate of a size header and rounding to 2 * sizeof( void * ). A
+// polymorphic T may be a base subobject of a larger object, at an address
+// malloc() did not return, and a T with its own operator new may come from
+// elsewhere, hence these are always estimated:
+
+template< class T, class C, class D >
+inline std::size_t allocated_size( T const * ptr ) nsvp_noexcept
+{
+#if nsvp_HAVE_MALLOC_USABLE_SIZE
+    if ( std::is_same<C, default_clone<T> >::value && std::is_same<D, default_delete<T> >::value
+        && ! std::is_polymorphic<T>::value && ! decltype( has_member_operator_new<T>( 0 ) )::value )
+        return ::malloc_usable_size( const_cast<T *>( ptr ) );
+#else
+    (void) ptr;
+#endif
+    std::size_t const align = 2 * sizeof( void * );
+    return ( sizeof( T ) + sizeof( std::size_t ) + align - 1 ) / align * align;
+}
+
+} // namespace detail
+
+template< class T, class C, class D >
+inline footprint owned_bytes( value_ptr<T, C, D> const & vp )
+{
+    typedef value_ptr<T, C, D> link_type;
+
+    footprint result = { 0, 0, 0, 0, 0, std::vector<std::size_t>() };
+
+    std::vector< std::pair<link_type *, std::size_t> > stack( 1, std::make_pair( const_cast<link_type *>( &vp ), std::size_t( 1 ) ) );
+    std::vector<link_type *> links;
+
+    // links are only read, visit_children() may take a non-const node:
+
+    while ( ! stack.empty() )
+    {
+        link_type * const link  = stack.back().first;
+        std::size_t const depth = stack.back().second;
+        stack.pop_back();
+
+        if ( ! *link )
+            continue;
+
+        ++result.nodes;
+        result.max_depth        = depth > result.max_depth ? depth : result.max_depth;
+        result.node_bytes      += sizeof( T );
+        result.allocated_bytes += detail::allocated_size<T, C, D>( link->get() );
+        result.payload_bytes   += detail::owned_payload_bytes_of( **link, 0 );
+
+        links.clear();
+        detail::collect_links< link_type, std::vector<link_type *> > f = { links };
+        detail::visit_children_of( **link, f, 0 );
+
+        std::size_t children = 0;
+
+        for ( link_type * child : links )
+        {
+            if ( ! *child )
+                continue;
+
+            ++children;
+            stack.push_back( std::make_pair( child, depth + 1 ) );
+        }
+
+        if ( result.fanout.size() <= children )
+            result.fanout.resize( children + 1 );
+
+        ++result.fanout[ children ];
+    }
+    return result;
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_FOOTPRINT_LITE_HPP
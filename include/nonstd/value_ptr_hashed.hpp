@@ -0,0 +1,319 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: hashed_value_ptr.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_HASHED_LITE_HPP
+#define NONSTD_VALUE_PTR_HASHED_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// value_ptr with the hash of its content cached next to the pointer. The hash
+// is computed on first use and invalidated by each modification. A mutable
+// reference handed out would outlive the invalidation, hence the content is
+// only mutable via modify(), which invalidates after the change:
+
+template
+<
+    class T
+    , class Cloner  = detail::default_clone<T>
+    , class Deleter = detail::default_delete<T>
+>
+class hashed_value_ptr
+{
+public:
+    typedef value_ptr<T, Cloner, Deleter> value_ptr_type;
+
+    typedef T         element_type;
+    typedef T *       pointer;
+    typedef T &       reference;
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    // Lifetime
+
+    hashed_value_ptr() nsvp_noexcept
+    : vp_()
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( std::nullptr_t ) nsvp_noexcept
+    : vp_()
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( value_ptr_type const & vp )
+    : vp_( vp )
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( value_ptr_type && vp ) nsvp_noexcept
+    : vp_( std::move( vp ) )
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( element_type const & value )
+    : vp_( value )
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( element_type && value )
+    : vp_( std::move( value ) )
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    template< class... Args
+        nsvp_REQUIRES_T(
+            std::is_constructible<T, Args&&...>::value )
+    >
+    explicit hashed_value_ptr( nonstd_lite_in_place_t(T), Args&&... args )
+    : vp_( nonstd_lite_in_place(T), std::forward<Args>(args)...)
+    , hash_( 0 )
+    , hashed_( false )
+    {}
+
+    hashed_value_ptr( hashed_value_ptr const & other )
+    : vp_( other.vp_ )
+    , hash_( 0 )
+    , hashed_( false )
+    {
+        copy_hash( other );
+    }
+
+    hashed_value_ptr( hashed_value_ptr && other ) nsvp_noexcept
+    : vp_( std::move( other.vp_ ) )
+    , hash_( 0 )
+    , hashed_( false )
+    {
+        copy_hash( other );
+        other.invalidate();
+    }
+
+    hashed_value_ptr & operator=( hashed_value_ptr const & rhs )
+    {
+        vp_ = rhs.vp_;
+        copy_hash( rhs );
+        return *this;
+    }
+
+    hashed_value_ptr & operator=( hashed_value_ptr && rhs ) nsvp_noexcept
+    {
+        if ( this == &rhs )
+            return *this;
+
+        vp_ = std::move( rhs.vp_ );
+        copy_hash( rhs );
+        rhs.invalidate();
+        return *this;
+    }
+
+    hashed_value_ptr & operator=( std::nullptr_t ) nsvp_noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template< class U
+        nsvp_REQUIRES_T(
+            std::is_same< typename std::decay<U>::type, T>::value )
+    >
+    hashed_value_ptr & operator=( U && value )
+    {
+        invalidate();
+        vp_ = std::forward<U>( value );
+        return *this;
+    }
+
+    template< class... Args >
+    void emplace( Args&&... args )
+    {
+        invalidate();
+        vp_.emplace( std::forward<Args>(args)...);
+    }
+
+    // Observers:
+
+    const_pointer get() const nsvp_noexcept
+    {
+        return vp_.get();
+    }
+
+    const_reference operator*() const
+    {
+        return *vp_;
+    }
+
+    const_pointer operator->() const nsvp_noexcept
+    {
+        return vp_.operator->();
+    }
+
+    const_reference value() const
+    {
+        return vp_.value();
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return has_value();
+    }
+
+    bool has_value() const nsvp_noexcept
+    {
+        return vp_.has_value();
+    }
+
+    value_ptr_type const & as_value_ptr() const nsvp_noexcept
+    {
+        return vp_;
+    }
+
+    // hash of content, or a fixed value if empty; computed once:
+
+    std::size_t hash() const
+    {
+        if ( hashed_.load( std::memory_order_acquire ) )
+            return hash_.load( std::memory_order_relaxed );
+
+        std::size_t const result = detail::hash_content( vp_.get() );
+
+        hash_.store( result, std::memory_order_relaxed );
+        hashed_.store( true, std::memory_order_release );
+        return result;
+    }
+
+    // Modifiers:
+
+    // apply f to the content and invalidate the cached hash, also if f throws:
+
+    template< class F >
+    void modify( F && f )
+    {
+        struct invalidate_guard
+        {
+            hashed_value_ptr * self;
+            ~invalidate_guard() { self->invalidate(); }
+        } guard = { this };
+
+        std::forward<F>( f )( vp_.value() );
+    }
+
+    pointer release() nsvp_noexcept
+    {
+        invalidate(); return vp_.release();
+    }
+
+    void reset( pointer p = pointer() ) nsvp_noexcept
+    {
+        invalidate(); vp_.reset( p );
+    }
+
+    void swap( hashed_value_ptr & other ) nsvp_noexcept
+    {
+        vp_.swap( other.vp_ );
+
+        std::size_t const h = hash_.load( std::memory_order_relaxed );
+        bool const hashed = hashed_.load( std::memory_order_relaxed );
+
+        hash_.store( other.hash_.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        hashed_.store( other.hashed_.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        other.hash_.store( h, std::memory_order_relaxed );
+        other.hashed_.store( hashed, std::memory_order_relaxed );
+    }
+
+private:
+    // the cached hash is valid while hashed_ is set, so that any hash value
+    // is cached, including 0:
+
+    void copy_hash( hashed_value_ptr const & other ) nsvp_noexcept
+    {
+        bool const hashed = other.hashed_.load( std::memory_order_acquire );
+
+        hash_.store( other.hash_.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        hashed_.store( hashed, std::memory_order_release );
+    }
+
+    void invalidate() nsvp_noexcept
+    {
+        hashed_.store( false, std::memory_order_relaxed );
+    }
+
+    value_ptr_type vp_;
+    mutable std::atomic<std::size_t> hash_;
+    mutable std::atomic<bool> hashed_;
+};
+
+// compare cached hashes before comparing content:
+
+template< class T, class C, class D >
+inline bool operator==( hashed_value_ptr<T, C, D> const & lhs, hashed_value_ptr<T, C, D> const & rhs )
+{
+    if ( lhs.hash() != rhs.hash() )
+        return false;
+
+    return bool(lhs) != bool(rhs) ? false : bool(lhs) == false ? true : *lhs == *rhs;
+}
+
+template< class T, class C, class D >
+inline bool operator!=( hashed_value_ptr<T, C, D> const & lhs, hashed_value_ptr<T, C, D> const & rhs )
+{
+    return ! ( lhs == rhs );
+}
+
+template< class T, class C, class D >
+inline void swap( hashed_value_ptr<T, C, D> & lhs, hashed_value_ptr<T, C, D> & rhs ) nsvp_noexcept
+{
+    lhs.swap( rhs );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#if nsvp_CPP11_OR_GREATER
+
+namespace std
+{
+
+template< class T, class C, class D >
+struct hash< nonstd::hashed_value_ptr<T, C, D> >
+{
+    typedef nonstd::hashed_value_ptr<T, C, D> argument_type;
+    typedef size_t result_type;
+
+    result_type operator()( argument_type const & p ) const nsvp_noexcept
+    {
+        return p.hash();
+    }
+};
+
+} // namespace std
+
+#endif // nsvp_CPP11_OR_GREATER
+
+#endif // NONSTD_VALUE_PTR_HASHED_LITE_HPP
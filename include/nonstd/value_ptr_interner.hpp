@@ -0,0 +1,248 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: interner and sharded_interner.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_INTERNER_LITE_HPP
+#define NONSTD_VALUE_PTR_INTERNER_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <mutex>
+# include <unordered_map>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Interning, a.k.a. hash-consing:
+
+template< class T, class Hash, class KeyEqual >
+class interner;
+
+// handle to the canonical copy of a value held by an interner:
+
+template< class T >
+class interned
+{
+public:
+    typedef T         element_type;
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    interned() nsvp_noexcept
+    : ptr_( nullptr )
+    {}
+
+    const_pointer get() const nsvp_noexcept
+    {
+        return ptr_;
+    }
+
+    const_reference operator*() const
+    {
+        assert( get() != nullptr ); return *get();
+    }
+
+    const_pointer operator->() const nsvp_noexcept
+    {
+        assert( get() != nullptr ); return get();
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return !! get();
+    }
+
+    // equal values share their canonical copy, so pointer comparison suffices:
+
+    friend bool operator==( interned const & lhs, interned const & rhs ) nsvp_noexcept
+    {
+        return lhs.ptr_ == rhs.ptr_;
+    }
+
+    friend bool operator!=( interned const & lhs, interned const & rhs ) nsvp_noexcept
+    {
+        return lhs.ptr_ != rhs.ptr_;
+    }
+
+private:
+    template< class U, class H, class E > friend class interner;
+
+    explicit interned( const_pointer p ) nsvp_noexcept
+    : ptr_( p )
+    {}
+
+    const_pointer ptr_;
+};
+
+// pool of canonical copies, deduplicated by content via Hash and KeyEqual.
+// Handles remain valid until the interner is cleared or destroyed:
+
+template< class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T> >
+class interner
+{
+public:
+    typedef T        value_type;
+    typedef Hash     hasher;
+    typedef KeyEqual key_equal;
+
+    interner( hasher const & hash = hasher(), key_equal const & equal = key_equal() )
+    : hash_( hash )
+    , equal_( equal )
+    , pool_()
+    {}
+
+    interned<T> intern( T const & value )
+    {
+        return intern( value, hash_( value ) );
+    }
+
+    interned<T> intern( T && value )
+    {
+        return intern( std::move( value ), hash_( value ) );
+    }
+
+    // intern value of which the hash has been computed already:
+
+    template< class U >
+    interned<T> intern( U && value, std::size_t hash )
+    {
+        typedef typename pool_type::iterator iterator;
+
+        std::pair<iterator, iterator> range = pool_.equal_range( hash );
+
+        for ( iterator pos = range.first; pos != range.second; ++pos )
+        {
+            if ( equal_( *pos->second, value ) )
+                return interned<T>( pos->second.get() );
+        }
+
+        iterator pos = pool_.emplace( hash, value_ptr<T>( std::forward<U>( value ) ) );
+        return interned<T>( pos->second.get() );
+    }
+
+    std::size_t size() const nsvp_noexcept
+    {
+        return pool_.size();
+    }
+
+    void clear() nsvp_noexcept
+    {
+        pool_.clear();
+    }
+
+private:
+    typedef std::unordered_multimap< std::size_t, value_ptr<T> > pool_type;
+
+    hasher    hash_;
+    key_equal equal_;
+    pool_type pool_;
+};
+
+// interner for concurrent producers, one mutex-protected interner per shard:
+
+template< class T, std::size_t Shards = 16, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T> >
+class sharded_interner
+{
+public:
+    typedef T        value_type;
+    typedef Hash     hasher;
+    typedef KeyEqual key_equal;
+
+    nsvp_static_assert( Shards > 0, "sharded_interner requires at least one shard" );
+
+    sharded_interner()
+    : hash_()
+    , shards_()
+    {}
+
+    template< class U >
+    interned<T> intern( U && value )
+    {
+        std::size_t const hash = hash_( value );
+        shard & s = shard_for( hash );
+
+        std::lock_guard<std::mutex> lock( s.mutex );
+        return s.pool.intern( std::forward<U>( value ), hash );
+    }
+
+    std::size_t size() const
+    {
+        std::size_t result = 0;
+
+        for ( std::size_t i = 0; i < Shards; ++i )
+        {
+            std::lock_guard<std::mutex> lock( shards_[i].mutex );
+            result += shards_[i].pool.size();
+        }
+        return result;
+    }
+
+    void clear()
+    {
+        for ( std::size_t i = 0; i < Shards; ++i )
+        {
+            std::lock_guard<std::mutex> lock( shards_[i].mutex );
+            shards_[i].pool.clear();
+        }
+    }
+
+private:
+    // keep shards on separate cache lines:
+
+    struct alignas(64) shard
+    {
+        mutable std::mutex mutex;
+        interner<T, Hash, KeyEqual> pool;
+    };
+
+    shard & shard_for( std::size_t hash ) nsvp_noexcept
+    {
+        // mix high bits in, as std::hash may be the identity:
+        return shards_[ ( hash ^ ( hash >> 16 ) ) % Shards ];
+    }
+
+    hasher hash_;
+    shard  shards_[ Shards ];
+};
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#if nsvp_CPP11_OR_GREATER
+
+namespace std
+{
+
+template< class T >
+struct hash< nonstd::interned<T> >
+{
+    typedef nonstd::interned<T> argument_type;
+    typedef size_t result_type;
+
+    result_type operator()( argument_type const & p ) const nsvp_noexcept
+    {
+        return hash<typename argument_type::const_pointer>()( p.get() );
+    }
+};
+
+} // namespace std
+
+#endif // nsvp_CPP11_OR_GREATER
+
+#endif // NONSTD_VALUE_PTR_INTERNER_LITE_HPP
@@ -0,0 +1,796 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: serialize(), deserialize(), freeze() and mmap_view.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_IO_LITE_HPP
+#define NONSTD_VALUE_PTR_IO_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <cstddef>
+# include <cstdint>
+# include <cstring>
+# include <string>
+# include <unordered_map>
+# include <vector>
+#endif
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/uio.h>
+# include <unistd.h>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Binary serialization of a value_ptr and the tree of value_ptr-s below it:
+//
+// Each link is written in depth-first order as a tag byte, 0 if empty, 1 if
+// engaged, followed for an engaged link by the payload of its content and by
+// its children as enumerated via visit_children( node, f ), see compact().
+// Children must be of the same value_ptr type as the root. Neither writing
+// nor reading recurses, both use an explicit stack.
+//
+// The payload is written via an unqualified call serialize_payload( writer, value )
+// and read into a value-initialized T via deserialize_payload( reader, value ),
+// which returns false on failure; both skip the value_ptr children, but must
+// cover what determines them, such as their number. Provided
+// are overloads for arithmetic and enumeration types, in host byte order, and
+// for std::string.
+//
+// A writer provides write( void const * data, std::size_t size ) and good(),
+// a reader provides bool read( void * data, std::size_t size ), good() and
+// fail(), which puts it in the failed state.
+
+// memory writer, appends to a vector of bytes:
+
+class buffer_writer
+{
+public:
+    void write( void const * data, std::size_t size )
+    {
+        unsigned char const * p = static_cast<unsigned char const *>( data );
+        bytes_.insert( bytes_.end(), p, p + size );
+    }
+
+    bool good() const nsvp_noexcept
+    {
+        return true;
+    }
+
+    std::vector<unsigned char> const & bytes() const nsvp_noexcept
+    {
+        return bytes_;
+    }
+
+private:
+    std::vector<unsigned char> bytes_;
+};
+
+// memory reader, reads from a range of bytes it does not own:
+
+class buffer_reader
+{
+public:
+    buffer_reader( void const * data, std::size_t size ) nsvp_noexcept
+    : next_( static_cast<unsigned char const *>( data ) )
+    , end_( next_ + size )
+    , good_( true )
+    {}
+
+    bool read( void * data, std::size_t size ) nsvp_noexcept
+    {
+        if ( ! good_ || static_cast<std::size_t>( end_ - next_ ) < size )
+        {
+            fail();
+            return false;
+        }
+
+        std::memcpy( data, next_, size );
+        next_ += size;
+        return true;
+    }
+
+    bool good() const nsvp_noexcept
+    {
+        return good_;
+    }
+
+    void fail() nsvp_noexcept
+    {
+        good_ = false;
+    }
+
+    std::size_t remaining() const nsvp_noexcept
+    {
+        return static_cast<std::size_t>( end_ - next_ );
+    }
+
+private:
+    unsigned char const * next_;
+    unsigned char const * end_;
+    bool good_;
+};
+
+#if nsvp_HAVE_POSIX_IO
+
+namespace detail {
+
+// write all of iov[0..count) to fd, retrying partial and interrupted writes:
+
+inline bool writev_all( int fd, ::iovec * iov, int count ) nsvp_noexcept
+{
+    while ( count > 0 )
+    {
+        ::ssize_t written = ::writev( fd, iov, count );
+
+        if ( written < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+
+        std::size_t n = static_cast<std::size_t>( written );
+
+        while ( count > 0 && n >= iov->iov_len )
+        {
+            n -= iov->iov_len;
+            ++iov; --count;
+        }
+
+        if ( count > 0 )
+        {
+            iov->iov_base = static_cast<char *>( iov->iov_base ) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+// buffered writer to a file descriptor it does not own; a write that does not
+// fit the buffer is passed to writev() together with the buffered data:
+
+class fd_writer
+{
+public:
+    explicit fd_writer( int fd, std::size_t capacity = 64 * 1024 )
+    : fd_( fd )
+    , buffer_( capacity )
+    , size_( 0 )
+    , good_( true )
+    {}
+
+    ~fd_writer()
+    {
+        flush();
+    }
+
+    fd_writer( fd_writer const & ) = delete;
+    fd_writer & operator=( fd_writer const & ) = delete;
+
+    void write( void const * data, std::size_t size )
+    {
+        if ( ! good_ )
+            return;
+
+        if ( size <= buffer_.size() - size_ )
+        {
+            std::memcpy( buffer_.data() + size_, data, size );
+            size_ += size;
+            return;
+        }
+
+        ::iovec iov[2];
+
+        iov[0].iov_base = buffer_.data();
+        iov[0].iov_len  = size_;
+        iov[1].iov_base = const_cast<void *>( data );
+        iov[1].iov_len  = size;
+
+        good_ = detail::writev_all( fd_, iov, 2 );
+        size_ = 0;
+    }
+
+    bool flush() nsvp_noexcept
+    {
+        if ( good_ && size_ > 0 )
+        {
+            ::iovec iov[1];
+
+            iov[0].iov_base = buffer_.data();
+            iov[0].iov_len  = size_;
+
+            good_ = detail::writev_all( fd_, iov, 1 );
+        }
+        size_ = 0;
+        return good_;
+    }
+
+    bool good() const nsvp_noexcept
+    {
+        return good_;
+    }
+
+private:
+    int fd_;
+    std::vector<unsigned char> buffer_;
+    std::size_t size_;
+    bool good_;
+};
+
+// buffered reader from a file descriptor it does not own:
+
+class fd_reader
+{
+public:
+    explicit fd_reader( int fd, std::size_t capacity = 64 * 1024 )
+    : fd_( fd )
+    , buffer_( capacity )
+    , next_( 0 )
+    , size_( 0 )
+    , good_( true )
+    {}
+
+    fd_reader( fd_reader const & ) = delete;
+    fd_reader & operator=( fd_reader const & ) = delete;
+
+    bool read( void * data, std::size_t size ) nsvp_noexcept
+    {
+        unsigned char * out = static_cast<unsigned char *>( data );
+
+        while ( good_ && size > 0 )
+        {
+            if ( next_ == size_ && ! refill() )
+                break;
+
+            std::size_t const n = size < size_ - next_ ? size : size_ - next_;
+
+            std::memcpy( out, buffer_.data() + next_, n );
+            next_ += n; out += n; size -= n;
+        }
+        return good_;
+    }
+
+    bool good() const nsvp_noexcept
+    {
+        return good_;
+    }
+
+    void fail() nsvp_noexcept
+    {
+        good_ = false;
+    }
+
+private:
+    bool refill() nsvp_noexcept
+    {
+        for (;;)
+        {
+            ::ssize_t n = ::read( fd_, buffer_.data(), buffer_.size() );
+
+            if ( n < 0 && errno == EINTR )
+                continue;
+
+            if ( n <= 0 )
+            {
+                fail();
+                return false;
+            }
+
+            next_ = 0;
+            size_ = static_cast<std::size_t>( n );
+            return true;
+        }
+    }
+
+    int fd_;
+    std::vector<unsigned char> buffer_;
+    std::size_t next_;
+    std::size_t size_;
+    bool good_;
+};
+
+#endif // nsvp_HAVE_POSIX_IO
+
+// payload of arithmetic and enumeration types:
+
+template< class Writer, class T
+    nsvp_REQUIRES_T( std::is_arithmetic<T>::value || std::is_enum<T>::value )
+>
+inline void serialize_payload( Writer & writer, T const & value )
+{
+    writer.write( &value, sizeof value );
+}
+
+template< class Reader, class T
+    nsvp_REQUIRES_T( std::is_arithmetic<T>::value || std::is_enum<T>::value )
+>
+inline bool deserialize_payload( Reader & reader, T & value )
+{
+    return reader.read( &value, sizeof value );
+}
+
+// payload of std::string, length followed by characters:
+
+template< class Writer >
+inline void serialize_payload( Writer & writer, std::string const & value )
+{
+    std::uint64_t const size = value.size();
+
+    writer.write( &size, sizeof size );
+    writer.write( value.data(), value.size() );
+}
+
+// reads in pieces, so that a corrupt length fails on missing input rather than
+// on allocation:
+
+template< class Reader >
+inline bool deserialize_payload( Reader & reader, std::string & value )
+{
+    std::uint64_t size = 0;
+
+    if ( ! reader.read( &size, sizeof size ) )
+        return false;
+
+    value.clear();
+
+    char piece[ 4096 ];
+
+    while ( size > 0 )
+    {
+        std::size_t const n = size < sizeof piece ? static_cast<std::size_t>( size ) : sizeof piece;
+
+        if ( ! reader.read( piece, n ) )
+            return false;
+
+        value.append( piece, n );
+        size -= n;
+    }
+    return true;
+}
+
+namespace detail {
+
+// links of node, pushed in reverse to visit them in order when popped:
+
+template< class Link, class T >
+inline void push_links( T & node, std::vector<Link *> & stack, std::vector<Link *> & links )
+{
+    links.clear();
+    collect_links< Link, std::vector<Link *> > f = { links };
+    visit_children_of( node, f, 0 );
+    stack.insert( stack.end(), links.rbegin(), links.rend() );
+}
+
+} // namespace detail
+
+// write vp and the tree below it, return writer.good():
+
+template< class Writer, class T, class C, class D >
+inline bool serialize( Writer & writer, value_ptr<T, C, D> const & vp )
+{
+    typedef value_ptr<T, C, D> link_type;
+
+    std::vector<link_type *> stack( 1, const_cast<link_type *>( &vp ) );
+    std::vector<link_type *> links;
+
+    // links are only read, visit_children() may take a non-const node:
+
+    while ( ! stack.empty() && writer.good() )
+    {
+        link_type * link = stack.back(); stack.pop_back();
+
+        unsigned char const tag = *link ? 1 : 0;
+        writer.write( &tag, 1 );
+
+        if ( tag == 0 )
+            continue;
+
+        serialize_payload( writer, **link );
+        detail::push_links( **link, stack, links );
+    }
+    return writer.good();
+}
+
+// read a tree written by serialize() into vp, return reader.good(); on
+// failure, vp is empty and the reader is in the failed state:
+
+template< class Reader, class T, class C, class D >
+inline bool deserialize( Reader & reader, value_ptr<T, C, D> & vp )
+{
+    typedef value_ptr<T, C, D> link_type;
+
+    link_type result;
+    std::vector<link_type *> stack( 1, &result );
+    std::vector<link_type *> links;
+
+    while ( ! stack.empty() )
+    {
+        link_type * link = stack.back(); stack.pop_back();
+
+        unsigned char tag = 0;
+
+        if ( ! reader.read( &tag, 1 ) || tag > 1 )
+        {
+            reader.fail();
+            break;
+        }
+
+        if ( tag == 0 )
+            continue;
+
+        link->emplace();
+
+        if ( ! deserialize_payload( reader, **link ) )
+        {
+            reader.fail();
+            break;
+        }
+
+        detail::push_links( **link, stack, links );
+    }
+
+    if ( reader.good() )
+        vp = std::move( result );
+    else
+        vp.reset();
+
+    return reader.good();
+}
+
+// read a tree of value_ptr<T> written by serialize(), empty on failure:
+
+template< class T, class Reader >
+inline value_ptr<T> deserialize( Reader & reader )
+{
+    value_ptr<T> vp;
+    deserialize( reader, vp );
+    return vp;
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+
+// Frozen trees, written to a file and mapped back without parsing:
+//
+// freeze() writes the nodes of a tree of value_ptr-s, enumerated via
+// visit_children( node, f ), as byte images into a file, in depth-first order.
+// Each link is replaced by the offset of its target relative to the link
+// itself, hence the file is relocatable. mmap_view maps the file privately,
+// turns these offsets into pointers in a single pass and then makes the
+// mapping read-only, so that the tree can be navigated via T const &. The
+// value_ptr links in a node do not propagate const to their content, hence
+// follow them via mmap_view::get( link ), which yields T const *; writing
+// through a link faults. thaw() yields a mutable heap copy of the tree.
+//
+// Apart from its value_ptr links, which must be of the same type as the root,
+// T must be trivially copyable, i.e. hold no pointers or resources, and not
+// polymorphic. Nodes in a mapping are never destroyed.
+
+namespace detail {
+
+struct frozen_header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t node_size;
+    std::uint64_t count;
+};
+
+inline frozen_header make_frozen_header( std::size_t node_size, std::size_t count ) nsvp_noexcept
+{
+    frozen_header header;
+
+    std::memset( &header, 0, sizeof header );
+    std::memcpy( header.magic, "nsvpfrz", 8 );
+    header.version   = 1;
+    header.node_size = static_cast<std::uint32_t>( node_size );
+    header.count     = count;
+    return header;
+}
+
+template< class T >
+inline std::size_t frozen_nodes_offset() nsvp_noexcept
+{
+    return ( sizeof( frozen_header ) + alignof( T ) - 1 ) / alignof( T ) * alignof( T );
+}
+
+template< class Link, class T >
+inline void links_of( T & node, std::vector<Link *> & links )
+{
+    links.clear();
+    collect_links< Link, std::vector<Link *> > f = { links };
+    visit_children_of( node, f, 0 );
+}
+
+} // namespace detail
+
+// write the tree at root to the file at path, return true on success:
+
+template< class T, class C, class D >
+inline bool freeze( value_ptr<T, C, D> const & root, char const * path )
+{
+    nsvp_static_assert( ! std::is_polymorphic<T>::value, "freeze() requires a non-polymorphic type" );
+
+    typedef value_ptr<T, C, D> link_type;
+
+    // number the nodes in depth-first order; links are only read:
+
+    std::vector<T *> order;
+    std::unordered_map<T const *, std::size_t> index;
+    std::vector<link_type *> links;
+
+    if ( root )
+    {
+        std::vector<T *> stack( 1, const_cast<T *>( root.get() ) );
+
+        while ( ! stack.empty() )
+        {
+            T * node = stack.back(); stack.pop_back();
+
+            index[ node ] = order.size();
+            order.push_back( node );
+
+            detail::links_of( *node, links );
+            for ( auto it = links.rbegin(); it != links.rend(); ++it )
+                if ( **it ) stack.push_back( ( *it )->get() );
+        }
+    }
+
+    int const fd = ::open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+    if ( fd < 0 )
+        return false;
+
+    bool result = false;
+    {
+        fd_writer writer( fd );
+
+        detail::frozen_header const header = detail::make_frozen_header( sizeof( T ), order.size() );
+        std::size_t const nodes = detail::frozen_nodes_offset<T>();
+        std::vector<unsigned char> image( nodes - sizeof header + sizeof( T ) );
+
+        writer.write( &header, sizeof header );
+        writer.write( image.data(), nodes - sizeof header );
+
+        image.resize( sizeof( T ) );
+
+        for ( std::size_t i = 0; i != order.size(); ++i )
+        {
+            std::memcpy( image.data(), static_cast<void const *>( order[i] ), sizeof( T ) );
+
+            detail::links_of( *order[i], links );
+
+            for ( link_type * link : links )
+            {
+                std::size_t const at = static_cast<std::size_t>( reinterpret_cast<char const *>( link ) - reinterpret_cast<char const *>( order[i] ) );
+                std::ptrdiff_t offset = 0;
+
+                if ( *link )
+                    offset = static_cast<std::ptrdiff_t>( sizeof( T ) * index[ link->get() ] ) - static_cast<std::ptrdiff_t>( sizeof( T ) * i + at );
+
+                std::memset( image.data() + at, 0, sizeof( link_type ) );
+                std::memcpy( image.data() + at, &offset, sizeof offset );
+            }
+            writer.write( image.data(), image.size() );
+        }
+        result = writer.flush();
+    }
+    return ::close( fd ) == 0 && result;
+}
+
+// read-only view of a tree written by freeze(), valid while the view lives:
+
+template
+<
+    class T
+    , class Cloner  = detail::default_clone<T>
+    , class Deleter = detail::default_delete<T>
+>
+class mmap_view
+{
+public:
+    typedef value_ptr<T, Cloner, Deleter> value_ptr_type;
+
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    explicit mmap_view( char const * path )
+    : base_( nullptr )
+    , size_( 0 )
+    , count_( 0 )
+    {
+        nsvp_static_assert( sizeof( value_ptr_type ) >= sizeof( std::ptrdiff_t ), "mmap_view requires links that can hold an offset" );
+
+        int const fd = ::open( path, O_RDONLY );
+
+        if ( fd < 0 )
+            return;
+
+        struct ::stat st;
+
+        if ( ::fstat( fd, &st ) == 0 && static_cast<std::size_t>( st.st_size ) >= sizeof( detail::frozen_header ) )
+        {
+            size_ = static_cast<std::size_t>( st.st_size );
+            void * base = ::mmap( nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+            base_ = base != MAP_FAILED ? static_cast<char *>( base ) : nullptr;
+        }
+        ::close( fd );
+
+        if ( base_ && ! ( relocate() && ::mprotect( base_, size_, PROT_READ ) == 0 ) )
+            unmap();
+    }
+
+    ~mmap_view()
+    {
+        unmap();
+    }
+
+    mmap_view( mmap_view && other ) nsvp_noexcept
+    : base_( other.base_ )
+    , size_( other.size_ )
+    , count_( other.count_ )
+    {
+        other.base_ = nullptr;
+    }
+
+    mmap_view( mmap_view const & ) = delete;
+    mmap_view & operator=( mmap_view const & ) = delete;
+
+    // true if the file was mapped and is a valid frozen tree:
+
+    bool good() const nsvp_noexcept
+    {
+        return base_ != nullptr;
+    }
+
+    // root node, or nullptr if the tree is empty or the view not good():
+
+    const_pointer get() const nsvp_noexcept
+    {
+        return good() && count_ > 0 ? node( 0 ) : nullptr;
+    }
+
+    const_reference root() const
+    {
+        assert( get() != nullptr ); return *get();
+    }
+
+    // content of a link of a node in view, as const:
+
+    const_pointer get( value_ptr_type const & link ) const nsvp_noexcept
+    {
+        return link.get();
+    }
+
+    std::size_t size() const nsvp_noexcept
+    {
+        return good() ? count_ : 0;
+    }
+
+    // heap copy of the tree, the way to modify it:
+
+    value_ptr_type thaw() const
+    {
+        return get() ? value_ptr_type( *get() ) : value_ptr_type();
+    }
+
+private:
+    T * node( std::size_t i ) const nsvp_noexcept
+    {
+        return reinterpret_cast<T *>( base_ + detail::frozen_nodes_offset<T>() + i * sizeof( T ) );
+    }
+
+    // replace the offsets in links by pointers, checking that they form the
+    // tree freeze() writes: each link addresses a node after its own, in
+    // depth-first order, and each node except the root is linked exactly once:
+
+    bool relocate()
+    {
+        detail::frozen_header header;
+        detail::frozen_header const expect = detail::make_frozen_header( sizeof( T ), 0 );
+
+        std::memcpy( &header, base_, sizeof header );
+
+        std::size_t const nodes = detail::frozen_nodes_offset<T>();
+
+        if ( std::memcmp( header.magic, expect.magic, sizeof header.magic ) != 0
+          || header.version != expect.version
+          || header.node_size != expect.node_size
+          || header.count > ( size_ - ( nodes < size_ ? nodes : size_ ) ) / sizeof( T ) )
+            return false;
+
+        count_ = static_cast<std::size_t>( header.count );
+
+        std::vector<value_ptr_type *> links;
+        std::vector<bool> linked( count_, false );
+        char const * const first = reinterpret_cast<char const *>( node( 0 ) );
+        std::size_t  const bytes = count_ * sizeof( T );
+
+        for ( std::size_t i = 0; i != count_; ++i )
+        {
+            detail::links_of( *node( i ), links );
+
+            for ( value_ptr_type * link : links )
+            {
+                std::ptrdiff_t offset = 0;
+                std::memcpy( &offset, static_cast<void const *>( link ), sizeof offset );
+
+                std::ptrdiff_t const target = ( reinterpret_cast<char const *>( link ) - first ) + offset;
+
+                if ( offset == 0 )
+                {
+                    ::new( static_cast<void *>( link ) ) value_ptr_type();
+                }
+                else if ( target >= 0 && static_cast<std::size_t>( target ) < bytes && static_cast<std::size_t>( target ) % sizeof( T ) == 0 )
+                {
+                    std::size_t const j = static_cast<std::size_t>( target ) / sizeof( T );
+
+                    if ( j <= i || linked[j] )
+                        return false;
+
+                    linked[j] = true;
+                    ::new( static_cast<void *>( link ) ) value_ptr_type( node( j ) );
+                }
+                else
+                {
+                    return false;
+                }
+            }
+        }
+
+        for ( std::size_t j = 1; j < count_; ++j )
+        {
+            if ( ! linked[j] )
+                return false;
+        }
+        return true;
+    }
+
+    void unmap() nsvp_noexcept
+    {
+        if ( base_ )
+            ::munmap( base_, size_ );
+        base_ = nullptr;
+    }
+
+    char * base_;
+    std::size_t size_;
+    std::size_t count_;
+};
+
+// heap copy of the tree in view:
+
+template< class T, class C, class D >
+inline value_ptr<T, C, D> thaw( mmap_view<T, C, D> const & view )
+{
+    return view.thaw();
+}
+
+#endif // nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_IO_LITE_HPP
@@ -0,0 +1,398 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: keyed_value_ptr.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_KEYED_LITE_HPP
+#define NONSTD_VALUE_PTR_KEYED_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <cstring>
+# include <string>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// value_ptr with a normalized key prefix of its content stored next to the
+// pointer. KeyFn writes size bytes such that, compared with std::memcmp, the
+// prefixes of two values order as the values do, or compare equal:
+//
+//     void operator()( T const & value, unsigned char * key, std::size_t size ) const;
+//
+// Comparisons resolve via the prefixes and dereference both sides only on a
+// tie, so sorting and searching a vector of keyed_value_ptr-s mostly touches
+// the vector's own cache lines. The prefix is recomputed at each modification,
+// hence the content is only mutable via modify(). keyed_value_ptr always
+// compares content, irrespective of nsvp_CONFIG_COMPARE_POINTERS.
+
+// key of the first size bytes of a string-like value, zero-padded; it orders
+// as std::char_traits<char>, i.e. as unsigned char:
+
+struct string_prefix_key
+{
+    template< class S >
+    void operator()( S const & value, unsigned char * key, std::size_t size ) const nsvp_noexcept
+    {
+        nsvp_static_assert( sizeof( *value.data() ) == 1, "string_prefix_key requires a string of single-byte characters" );
+
+        std::size_t const n = value.size() < size ? value.size() : size;
+
+        std::memcpy( key, value.data(), n );
+        std::memset( key + n, 0, size - n );
+    }
+};
+
+// key of an integral value, big-endian with the sign bit flipped; with fewer
+// bytes than the integer, only the most significant bytes are used:
+
+struct integral_key
+{
+    template< class I >
+    void operator()( I const & value, unsigned char * key, std::size_t size ) const nsvp_noexcept
+    {
+        nsvp_static_assert( std::is_integral<I>::value, "integral_key requires an integral type" );
+
+        typedef typename std::make_unsigned<I>::type U;
+
+        U const flip = std::is_signed<I>::value ? U( U(1) << ( 8 * sizeof(U) - 1 ) ) : U(0);
+        U const bits = U( static_cast<U>( value ) ^ flip );
+
+        for ( std::size_t i = 0; i < size; ++i )
+        {
+            key[i] = static_cast<unsigned char>( i < sizeof(U) ? bits >> ( 8 * ( sizeof(U) - 1 - i ) ) : 0 );
+        }
+    }
+};
+
+template
+<
+    class T
+    , class KeyFn
+    , std::size_t N = 8
+    , class Cloner  = detail::default_clone<T>
+    , class Deleter = detail::default_delete<T>
+>
+class keyed_value_ptr
+{
+public:
+    typedef value_ptr<T, Cloner, Deleter> value_ptr_type;
+
+    typedef T         element_type;
+    typedef T *       pointer;
+    typedef T const * const_pointer;
+    typedef T const & const_reference;
+
+    static const std::size_t key_size = N;
+
+    nsvp_static_assert( N > 0, "keyed_value_ptr requires a non-empty key" );
+
+    // Lifetime
+
+    keyed_value_ptr() nsvp_noexcept
+    : vp_()
+    {
+        clear_key();
+    }
+
+    keyed_value_ptr( std::nullptr_t ) nsvp_noexcept
+    : vp_()
+    {
+        clear_key();
+    }
+
+    keyed_value_ptr( value_ptr_type const & vp )
+    : vp_( vp )
+    {
+        rekey();
+    }
+
+    keyed_value_ptr( value_ptr_type && vp )
+    : vp_( std::move( vp ) )
+    {
+        rekey();
+    }
+
+    keyed_value_ptr( element_type const & value )
+    : vp_( value )
+    {
+        rekey();
+    }
+
+    keyed_value_ptr( element_type && value )
+    : vp_( std::move( value ) )
+    {
+        rekey();
+    }
+
+    template< class... Args
+        nsvp_REQUIRES_T(
+            std::is_constructible<T, Args&&...>::value )
+    >
+    explicit keyed_value_ptr( nonstd_lite_in_place_t(T), Args&&... args )
+    : vp_( nonstd_lite_in_place(T), std::forward<Args>(args)...)
+    {
+        rekey();
+    }
+
+    keyed_value_ptr( keyed_value_ptr const & other )
+    : vp_( other.vp_ )
+    {
+        std::memcpy( key_, other.key_, N );
+    }
+
+    keyed_value_ptr( keyed_value_ptr && other ) nsvp_noexcept
+    : vp_( std::move( other.vp_ ) )
+    {
+        std::memcpy( key_, other.key_, N );
+        other.clear_key();
+    }
+
+    keyed_value_ptr & operator=( keyed_value_ptr const & rhs )
+    {
+        vp_ = rhs.vp_;
+        std::memmove( key_, rhs.key_, N );
+        return *this;
+    }
+
+    keyed_value_ptr & operator=( keyed_value_ptr && rhs ) nsvp_noexcept
+    {
+        if ( this == &rhs )
+            return *this;
+
+        vp_ = std::move( rhs.vp_ );
+        std::memcpy( key_, rhs.key_, N );
+        rhs.clear_key();
+        return *this;
+    }
+
+    keyed_value_ptr & operator=( std::nullptr_t ) nsvp_noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template< class U
+        nsvp_REQUIRES_T(
+            std::is_same< typename std::decay<U>::type, T>::value )
+    >
+    keyed_value_ptr & operator=( U && value )
+    {
+        vp_ = std::forward<U>( value );
+        rekey();
+        return *this;
+    }
+
+    template< class... Args >
+    void emplace( Args&&... args )
+    {
+        clear_key();
+        vp_.emplace( std::forward<Args>(args)...);
+        rekey();
+    }
+
+    // Observers, access is const only:
+
+    const_pointer get() const nsvp_noexcept
+    {
+        return vp_.get();
+    }
+
+    const_reference operator*() const
+    {
+        return *vp_;
+    }
+
+    const_pointer operator->() const nsvp_noexcept
+    {
+        return vp_.operator->();
+    }
+
+    const_reference value() const
+    {
+        return vp_.value();
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return has_value();
+    }
+
+    bool has_value() const nsvp_noexcept
+    {
+        return vp_.has_value();
+    }
+
+    value_ptr_type const & as_value_ptr() const nsvp_noexcept
+    {
+        return vp_;
+    }
+
+    // the key prefix of the content, all zero if empty:
+
+    unsigned char const * key() const nsvp_noexcept
+    {
+        return key_;
+    }
+
+    // Modifiers:
+
+    // apply f to the content and recompute the key prefix. If f or KeyFn
+    // throws, the key is recomputed by a KeyFn that does not throw, else the
+    // content is destroyed, so that the key matches the content:
+
+    template< class F >
+    void modify( F && f )
+    {
+        typedef std::integral_constant<bool, noexcept( KeyFn()( std::declval<T &>(), std::declval<unsigned char *>(), N ) )> nothrow_key;
+
+        struct recover_guard
+        {
+            keyed_value_ptr * self;
+            ~recover_guard() { if ( self ) self->recover( nothrow_key() ); }
+        } guard = { this };
+
+        std::forward<F>( f )( vp_.value() );
+        rekey();
+
+        guard.self = nullptr;
+    }
+
+    pointer release() nsvp_noexcept
+    {
+        clear_key(); return vp_.release();
+    }
+
+    void reset( pointer p = pointer() )
+    {
+        vp_.reset( p ); rekey();
+    }
+
+    void swap( keyed_value_ptr & other ) nsvp_noexcept
+    {
+        unsigned char key[N];
+
+        vp_.swap( other.vp_ );
+        std::memcpy( key, key_, N );
+        std::memcpy( key_, other.key_, N );
+        std::memcpy( other.key_, key, N );
+    }
+
+private:
+    void clear_key() nsvp_noexcept
+    {
+        std::memset( key_, 0, N );
+    }
+
+    void rekey()
+    {
+        if ( vp_ )
+            KeyFn()( *vp_, key_, N );
+        else
+            clear_key();
+    }
+
+    void recover( std::true_type ) nsvp_noexcept
+    {
+        rekey();
+    }
+
+    void recover( std::false_type ) nsvp_noexcept
+    {
+        vp_.reset();
+        clear_key();
+    }
+
+    value_ptr_type vp_;
+    unsigned char key_[N];
+};
+
+template< class T, class K, std::size_t N, class C, class D >
+const std::size_t keyed_value_ptr<T, K, N, C, D>::key_size;
+
+namespace detail {
+
+// three-way comparison of keyed_value_ptr-s as -1, 0, 1, empty first:
+
+template< class T, class K, std::size_t N, class C, class D >
+inline int compare_keyed( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    if ( !lhs || !rhs )
+        return int( bool(lhs) ) - int( bool(rhs) );
+
+    int const result = std::memcmp( lhs.key(), rhs.key(), N );
+
+    if ( result != 0 )
+        return result < 0 ? -1 : 1;
+
+    return *lhs < *rhs ? -1 : *rhs < *lhs ? 1 : 0;
+}
+
+} // namespace detail
+
+// compare key prefixes before comparing content:
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator==( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    if ( !lhs || !rhs )
+        return bool(lhs) == bool(rhs);
+
+    return std::memcmp( lhs.key(), rhs.key(), N ) == 0 && *lhs == *rhs;
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator!=( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    return ! ( lhs == rhs );
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator<( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    return detail::compare_keyed( lhs, rhs ) < 0;
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator<=( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    return detail::compare_keyed( lhs, rhs ) <= 0;
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator>( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    return detail::compare_keyed( lhs, rhs ) > 0;
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline bool operator>=( keyed_value_ptr<T, K, N, C, D> const & lhs, keyed_value_ptr<T, K, N, C, D> const & rhs )
+{
+    return detail::compare_keyed( lhs, rhs ) >= 0;
+}
+
+template< class T, class K, std::size_t N, class C, class D >
+inline void swap( keyed_value_ptr<T, K, N, C, D> & lhs, keyed_value_ptr<T, K, N, C, D> & rhs ) nsvp_noexcept
+{
+    lhs.swap( rhs );
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_KEYED_LITE_HPP
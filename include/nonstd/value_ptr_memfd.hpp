@@ -0,0 +1,329 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: memfd_clone, copy-on-write clones via memfd (Linux).
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_MEMFD_LITE_HPP
+#define NONSTD_VALUE_PTR_MEMFD_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstdint>
+# include <cstring>
+# include <new>
+#endif
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+// Presence of memfd_create(), Linux:
+
+#ifndef   nsvp_HAVE_MEMFD
+# if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO && defined( __linux__ ) && defined( MFD_CLOEXEC )
+#  define nsvp_HAVE_MEMFD  1
+# else
+#  define nsvp_HAVE_MEMFD  0
+# endif
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_HAVE_MEMFD
+
+// Copy-on-write clones of large trivially copyable objects via memfd:
+//
+// memfd_clone places an object in a private mapping of an in-memory file,
+// behind a page with the header of the mapping. A copy of such an object
+// maps the same file privately again, so that the kernel shares the pages
+// until either side writes them; only the pages the source has written since,
+// as reported by /proc/self/pagemap, are copied. Without pagemap, the whole
+// object is copied into the new mapping. All copies of an object share its
+// file descriptor, which is closed with the last of their mappings. Objects
+// smaller than a page are allocated on the heap, objects for which a file
+// cannot be mapped in an anonymous mapping. Use together with memfd_delete<T>;
+// a memfd_value_ptr of an object of a page or more only owns objects that
+// memfd_clone created.
+
+namespace detail {
+
+// the in-memory file shared by an object and its copies:
+
+struct memfd_file
+{
+    std::atomic<std::size_t> refs;
+    int fd;
+
+    explicit memfd_file( int fd_ ) nsvp_noexcept
+    : refs( 1 ), fd( fd_ )
+    {}
+};
+
+// header at the start of a mapping, one page in front of the object;
+// file is null for an anonymous mapping:
+
+struct memfd_header
+{
+    memfd_file * file;
+    std::size_t length;
+};
+
+class memfd_mapping
+{
+public:
+    static std::size_t page_size() nsvp_noexcept
+    {
+        static std::size_t const size = static_cast<std::size_t>( ::sysconf( _SC_PAGESIZE ) );
+        return size;
+    }
+
+    static memfd_header header_of( void const * object ) nsvp_noexcept
+    {
+        memfd_header h;
+        std::memcpy( &h, static_cast<char const *>( object ) - page_size(), sizeof h );
+        return h;
+    }
+
+    // new mapping of length bytes, holding the size bytes at data behind
+    // its header; of a new in-memory file if possible, else anonymous:
+
+    static void * create( void const * data, std::size_t size, std::size_t length )
+    {
+        int const fd = create_file( data, size, length );
+
+        if ( fd >= 0 )
+        {
+            if ( void * p = map( fd, length ) )
+            {
+                if ( memfd_file * file = new ( std::nothrow ) memfd_file( fd ) )
+                    return place( p, file, length );
+
+                ::munmap( p, length );
+            }
+            ::close( fd );
+        }
+
+        void * p = map( -1, length );
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( p != nullptr && "memfd_clone: cannot map memory" );
+#else
+        if ( p == nullptr )
+            throw std::bad_alloc();
+#endif
+        std::memcpy( static_cast<char *>( p ) + page_size(), data, size );
+        return place( p, nullptr, length );
+    }
+
+    // new mapping of the file of the object at src, which has size bytes:
+
+    static void * copy( void const * src, std::size_t size )
+    {
+        memfd_header const h = header_of( src );
+
+        if ( h.file )
+        {
+            if ( void * p = map( h.file->fd, h.length ) )
+            {
+                copy_written_pages( src, static_cast<char *>( p ) + page_size(), h.length - page_size() );
+                h.file->refs.fetch_add( 1, std::memory_order_relaxed );
+                return place( p, h.file, h.length );
+            }
+        }
+        return create( src, size, h.length );
+    }
+
+    // unmap the mapping of the object, and close its file with the last mapping:
+
+    static void destroy( void const * object ) nsvp_noexcept
+    {
+        memfd_header const h = header_of( object );
+
+        ::munmap( const_cast<char *>( static_cast<char const *>( object ) - page_size() ), h.length );
+
+        if ( h.file && h.file->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        {
+            ::close( h.file->fd );
+            delete h.file;
+        }
+    }
+
+private:
+    static void * place( void * p, memfd_file * file, std::size_t length ) nsvp_noexcept
+    {
+        memfd_header const h = { file, length };
+        std::memcpy( p, &h, sizeof h );
+        return static_cast<char *>( p ) + page_size();
+    }
+
+    // new in-memory file of length bytes, holding the size bytes at data
+    // behind the header page; -1 on failure:
+
+    static int create_file( void const * data, std::size_t size, std::size_t length ) nsvp_noexcept
+    {
+        int const fd = ::memfd_create( "nsvp", MFD_CLOEXEC );
+
+        if ( fd < 0 )
+            return -1;
+
+        if ( ::ftruncate( fd, static_cast< ::off_t >( length ) ) != 0 )
+            return ::close( fd ), -1;
+
+        char const * p = static_cast<char const *>( data );
+
+        for ( std::size_t done = 0; done < size; )
+        {
+            ::ssize_t n = ::pwrite( fd, p + done, size - done, static_cast< ::off_t >( page_size() + done ) );
+
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 )
+                return ::close( fd ), -1;
+
+            done += static_cast<std::size_t>( n );
+        }
+        return fd;
+    }
+
+    // private mapping of the file, or anonymous if fd is -1:
+
+    static void * map( int fd, std::size_t length ) nsvp_noexcept
+    {
+        void * p = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_PRIVATE, fd, 0 );
+        return p != MAP_FAILED ? p : nullptr;
+    }
+
+    // /proc/self/pagemap, -1 if unavailable; opened per copy rather than
+    // once, so that a child after fork() reads its own page table:
+
+    struct pagemap
+    {
+        int const fd;
+
+        pagemap() nsvp_noexcept
+        : fd( ::open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC ) )
+        {}
+
+        ~pagemap()
+        {
+            if ( fd >= 0 )
+                ::close( fd );
+        }
+    };
+
+    // copy the pages of the private mapping at src that differ from the file
+    // to dst, or all pages if these cannot be determined:
+
+    static void copy_written_pages( void const * src, void * dst, std::size_t length ) nsvp_noexcept
+    {
+        std::size_t const page  = page_size();
+        std::size_t const pages = length / page;
+
+        std::uint64_t const present = std::uint64_t(1) << 63;
+        std::uint64_t const swapped = std::uint64_t(1) << 62;
+        std::uint64_t const file    = std::uint64_t(1) << 61;
+
+        char const * const from = static_cast<char const *>( src );
+        char * const to = static_cast<char *>( dst );
+
+        std::uint64_t entries[ 512 ];
+
+        pagemap const table;
+
+        for ( std::size_t first = 0; first < pages; )
+        {
+            std::size_t const n = pages - first < 512 ? pages - first : 512;
+            std::size_t const bytes = n * sizeof entries[0];
+            ::off_t const offset = static_cast< ::off_t >( ( reinterpret_cast<std::uintptr_t>( from ) / page + first ) * sizeof entries[0] );
+
+            if ( table.fd < 0 || ::pread( table.fd, entries, bytes, offset ) != static_cast< ::ssize_t >( bytes ) )
+            {
+                std::memcpy( to + first * page, from + first * page, length - first * page );
+                return;
+            }
+
+            for ( std::size_t i = 0; i != n; ++i )
+            {
+                std::uint64_t const e = entries[i];
+
+                if ( ( ( e & present ) && ! ( e & file ) ) || ( e & swapped ) )
+                    std::memcpy( to + ( first + i ) * page, from + ( first + i ) * page, page );
+            }
+            first += n;
+        }
+    }
+};
+
+} // namespace detail
+
+template< class T >
+struct memfd_clone
+{
+    T * operator()( T const & x ) const
+    {
+        nsvp_static_assert( std::is_trivially_copyable<T>::value, "memfd_clone requires a trivially copyable type" );
+
+        if ( sizeof( T ) < detail::memfd_mapping::page_size() )
+            return new T( x );
+
+        return static_cast<T *>( detail::memfd_mapping::create( &x, sizeof( T ), length() ) );
+    }
+
+    // copy of an object that memfd_clone created:
+
+    T * copy( T const & x ) const
+    {
+        if ( sizeof( T ) < detail::memfd_mapping::page_size() )
+            return new T( x );
+
+        return static_cast<T *>( detail::memfd_mapping::copy( &x, sizeof( T ) ) );
+    }
+
+private:
+    // mapping length, the header page and the object:
+
+    static std::size_t length() nsvp_noexcept
+    {
+        std::size_t const page = detail::memfd_mapping::page_size();
+        return page + ( sizeof( T ) + page - 1 ) / page * page;
+    }
+};
+
+template< class T >
+struct memfd_delete
+{
+    void operator()( T * ptr ) const nsvp_noexcept
+    {
+        if ( ! ptr )
+            return;
+
+        if ( sizeof( T ) < detail::memfd_mapping::page_size() )
+            delete ptr;
+        else
+            detail::memfd_mapping::destroy( ptr );
+    }
+};
+
+template< class T >
+using memfd_value_ptr = value_ptr< T, memfd_clone<T>, memfd_delete<T> >;
+
+#endif // nsvp_HAVE_MEMFD
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_MEMFD_LITE_HPP
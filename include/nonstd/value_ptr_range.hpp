@@ -0,0 +1,310 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: prefetch_deref_view(), gather() and scatter().
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_RANGE_LITE_HPP
+#define NONSTD_VALUE_PTR_RANGE_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <iterator>
+# include <utility>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Prefetching traversal of a range of value_ptr-s: iterating yields the
+// content, while the content of the element distance positions ahead is
+// prefetched. All elements must be engaged:
+
+template< class Iterator >
+class prefetch_deref_iterator
+{
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef decltype( **std::declval<Iterator>() ) reference;
+    typedef typename std::remove_reference<reference>::type * pointer;
+    typedef typename std::remove_cv< typename std::remove_reference<reference>::type >::type value_type;
+    typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+
+    prefetch_deref_iterator()
+    : pos_(), ahead_(), last_()
+    {}
+
+    prefetch_deref_iterator( Iterator pos, Iterator ahead, Iterator last )
+    : pos_( pos ), ahead_( ahead ), last_( last )
+    {}
+
+    reference operator*() const
+    {
+        return **pos_;
+    }
+
+    pointer operator->() const
+    {
+        return ( *pos_ ).get();
+    }
+
+    prefetch_deref_iterator & operator++()
+    {
+        ++pos_;
+
+        if ( ahead_ != last_ )
+        {
+            ( *ahead_ ).prefetch();
+            ++ahead_;
+        }
+        return *this;
+    }
+
+    prefetch_deref_iterator operator++( int )
+    {
+        prefetch_deref_iterator result( *this );
+        ++*this;
+        return result;
+    }
+
+    friend bool operator==( prefetch_deref_iterator const & a, prefetch_deref_iterator const & b )
+    {
+        return a.pos_ == b.pos_;
+    }
+
+    friend bool operator!=( prefetch_deref_iterator const & a, prefetch_deref_iterator const & b )
+    {
+        return !( a == b );
+    }
+
+private:
+    Iterator pos_;
+    Iterator ahead_;
+    Iterator last_;
+};
+
+template< class Range >
+class prefetch_deref_range
+{
+public:
+    typedef decltype( std::begin( std::declval<Range &>() ) ) base_iterator;
+    typedef prefetch_deref_iterator<base_iterator> iterator;
+
+    prefetch_deref_range( Range & range, std::size_t distance ) nsvp_noexcept
+    : range_( range ), distance_( distance )
+    {}
+
+    // prefetch the first distance elements:
+
+    iterator begin() const
+    {
+        base_iterator first = std::begin( range_ );
+        base_iterator last  = std::end( range_ );
+        base_iterator ahead = first;
+
+        for ( std::size_t i = 0; i != distance_ && ahead != last; ++i, ++ahead )
+            ( *ahead ).prefetch();
+
+        return iterator( first, ahead, last );
+    }
+
+    iterator end() const
+    {
+        base_iterator last = std::end( range_ );
+        return iterator( last, last, last );
+    }
+
+private:
+    Range & range_;
+    std::size_t distance_;
+};
+
+template< class Range >
+inline prefetch_deref_range<Range> prefetch_deref_view( Range & range, std::size_t distance = 8 )
+{
+    return prefetch_deref_range<Range>( range, distance );
+}
+
+// Gather and scatter, between a member of the content of a range of
+// value_ptr-s and a dense array, e.g. for vectorized processing:
+
+// treatment of empty value_ptr-s: skip them, use a value-initialized value,
+// or use a value-initialized value and a false mask entry:
+
+enum class null_policy { skip, value_init, mask };
+
+namespace detail {
+
+// projection via member pointer or callable:
+
+template< class M, class C, class T >
+inline auto project( M C::* member, T & object ) nsvp_noexcept -> decltype( object.*member )
+{
+    return object.*member;
+}
+
+template< class F, class T >
+inline auto project( F & f, T & object ) -> decltype( f( object ) )
+{
+    return f( object );
+}
+
+// visit the elements, prefetching the content of elements ahead:
+
+std::size_t const prefetch_distance = 8;
+
+template< class Iterator, class F >
+inline void for_each_prefetched( Iterator first, Iterator last, F & f, std::random_access_iterator_tag )
+{
+    typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+
+    difference_type const size     = last - first;
+    difference_type const distance = static_cast<difference_type>( prefetch_distance );
+    difference_type i = 0;
+
+    for ( difference_type k = 0; k != distance && k < size; ++k )
+        first[ k ].prefetch();
+
+    // unrolled by 4:
+
+    for ( ; i + 4 <= size; i += 4 )
+    {
+        for ( difference_type k = i + distance; k != i + distance + 4 && k < size; ++k )
+            first[ k ].prefetch();
+
+        f( first[ i     ] );
+        f( first[ i + 1 ] );
+        f( first[ i + 2 ] );
+        f( first[ i + 3 ] );
+    }
+
+    for ( ; i != size; ++i )
+        f( first[ i ] );
+}
+
+template< class Iterator, class F >
+inline void for_each_prefetched( Iterator first, Iterator last, F & f, std::input_iterator_tag )
+{
+    Iterator ahead = first;
+
+    for ( std::size_t k = 0; k != prefetch_distance && ahead != last; ++k, ++ahead )
+        ( *ahead ).prefetch();
+
+    for ( ; first != last; ++first )
+    {
+        if ( ahead != last )
+        {
+            ( *ahead ).prefetch();
+            ++ahead;
+        }
+        f( *first );
+    }
+}
+
+template< class Iterator, class F >
+inline void for_each_prefetched( Iterator first, Iterator last, F f )
+{
+    for_each_prefetched( first, last, f, typename std::iterator_traits<Iterator>::iterator_category() );
+}
+
+} // namespace detail
+
+namespace detail {
+
+// mask iterator that ignores the mask entries:
+
+struct no_mask
+{
+    no_mask & operator*() nsvp_noexcept { return *this; }
+    no_mask & operator=( bool ) nsvp_noexcept { return *this; }
+    no_mask & operator++() nsvp_noexcept { return *this; }
+};
+
+template< class Range, class Projection, class OutputIt, class MaskIt >
+std::pair<OutputIt, MaskIt> gather_into( Range const & range, Projection & proj, OutputIt out, null_policy policy, MaskIt mask )
+{
+    typedef typename std::remove_reference<decltype( *std::begin( range ) )>::type::element_type element_type;
+    typedef typename std::decay<decltype( detail::project( proj, std::declval<element_type const &>() ) )>::type value_type;
+
+    detail::for_each_prefetched( std::begin( range ), std::end( range ), [&]( decltype( *std::begin( range ) ) vp )
+    {
+        if ( vp )
+        {
+            *out = detail::project( proj, static_cast<element_type const &>( *vp ) ); ++out;
+        }
+        else if ( policy != null_policy::skip )
+        {
+            *out = value_type(); ++out;
+        }
+
+        if ( policy == null_policy::mask )
+        {
+            *mask = bool( vp ); ++mask;
+        }
+    } );
+    return std::make_pair( out, mask );
+}
+
+} // namespace detail
+
+// copy the projection of the content of each element of range to out;
+// return the end of the output. null_policy::mask requires a mask iterator:
+
+template< class Range, class Projection, class OutputIt >
+OutputIt gather( Range const & range, Projection proj, OutputIt out, null_policy policy = null_policy::skip )
+{
+    assert( policy != null_policy::mask && "gather: null_policy::mask requires a mask iterator" );
+
+    return detail::gather_into( range, proj, out, policy, detail::no_mask() ).first;
+}
+
+// copy the projection of the content of each element of range to out and
+// whether the element is engaged to mask; policy must be null_policy::mask.
+// Return the ends of the output and of the mask:
+
+template< class Range, class Projection, class OutputIt, class MaskIt >
+std::pair<OutputIt, MaskIt> gather( Range const & range, Projection proj, OutputIt out, null_policy policy, MaskIt mask )
+{
+    assert( policy == null_policy::mask && "gather: a mask iterator requires null_policy::mask" );
+
+    return detail::gather_into( range, proj, out, policy, mask );
+}
+
+// assign the values from in to the projection of the content of each engaged
+// element of range. With null_policy::skip, in holds values for the engaged
+// elements only, otherwise it holds a value for each element and the values
+// for empty elements are ignored; return the end of the input consumed:
+
+template< class Range, class Projection, class InputIt >
+InputIt scatter( Range & range, Projection proj, InputIt in, null_policy policy = null_policy::skip )
+{
+    detail::for_each_prefetched( std::begin( range ), std::end( range ), [&]( decltype( *std::begin( range ) ) vp )
+    {
+        if ( vp )
+        {
+            detail::project( proj, *vp ) = *in; ++in;
+        }
+        else if ( policy != null_policy::skip )
+        {
+            ++in;
+        }
+    } );
+    return in;
+}
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_RANGE_LITE_HPP
@@ -0,0 +1,415 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: slab_value_ptr, clone_range() and compact().
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_SLAB_LITE_HPP
+#define NONSTD_VALUE_PTR_SLAB_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <cstddef>
+# include <iterator>
+# include <new>
+# include <unordered_map>
+# include <vector>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Slab allocation, clones of a range carved out of a single contiguous block:
+
+namespace detail {
+
+// a slab starts with a header that counts the live objects in it, and is
+// freed with the last of them:
+
+struct slab_header
+{
+    std::atomic<std::size_t> refs;
+    std::size_t size;
+
+    slab_header( std::size_t refs_, std::size_t size_ ) nsvp_noexcept
+    : refs( refs_ )
+    , size( size_ )
+    {}
+};
+
+template< class T >
+struct slab_block
+{
+    static std::size_t const offset = ( sizeof( slab_header ) + alignof( T ) - 1 ) / alignof( T ) * alignof( T );
+
+    // allocate a slab for size objects, with refs references held by the caller:
+
+    static slab_header * allocate( std::size_t size, std::size_t refs )
+    {
+        nsvp_static_assert( alignof( T ) <= alignof( std::max_align_t ), "slab allocation does not support over-aligned types" );
+
+        return ::new( ::operator new( offset + size * sizeof( T ) ) ) slab_header( refs, size );
+    }
+
+    static T * first( slab_header * slab ) nsvp_noexcept
+    {
+        return reinterpret_cast<T *>( reinterpret_cast<char *>( slab ) + offset );
+    }
+
+    static void acquire( slab_header * slab ) nsvp_noexcept
+    {
+        slab->refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    static void release( slab_header * slab ) nsvp_noexcept
+    {
+        if ( slab->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+            return;
+
+        slab->~slab_header();
+        ::operator delete( slab );
+    }
+};
+
+} // namespace detail
+
+// deleter that destroys objects living in a slab in place and releases their
+// reference to the slab, and deletes objects outside the slab, such as those
+// later assigned via the default cloner. It refers to the slab without owning
+// it, the objects in the slab do. A copy belongs to a copy of its value_ptr,
+// which holds a heap clone, hence it starts out in the heap state:
+
+template< class T >
+class slab_delete
+{
+public:
+    slab_delete() nsvp_noexcept
+    : slab_( nullptr )
+    {}
+
+    explicit slab_delete( detail::slab_header * slab ) nsvp_noexcept
+    : slab_( slab )
+    {}
+
+    slab_delete( slab_delete const & ) nsvp_noexcept
+    : slab_( nullptr )
+    {}
+
+    slab_delete( slab_delete && other ) nsvp_noexcept
+    : slab_( other.slab_ )
+    {
+        other.slab_ = nullptr;
+    }
+
+    slab_delete & operator=( slab_delete && other ) nsvp_noexcept
+    {
+        slab_ = other.slab_;
+        other.slab_ = nullptr;
+        return *this;
+    }
+
+    void operator()( T * ptr ) nsvp_noexcept
+    {
+        if ( owns( ptr ) )
+        {
+            ptr->~T();
+            detail::slab_block<T>::release( slab_ );
+            slab_ = nullptr;
+        }
+        else
+        {
+            delete ptr;
+        }
+    }
+
+    bool owns( T const * ptr ) const nsvp_noexcept
+    {
+        if ( ! ptr || ! slab_ )
+            return false;
+
+        std::less<T const *> less;
+        T const * first = detail::slab_block<T>::first( slab_ );
+
+        return ! less( ptr, first ) && less( ptr, first + slab_->size );
+    }
+
+    // number of live objects in the slab, 0 in the heap state:
+
+    std::size_t use_count() const nsvp_noexcept
+    {
+        return slab_ ? slab_->refs.load( std::memory_order_relaxed ) : 0;
+    }
+
+private:
+    detail::slab_header * slab_;
+};
+
+template< class T >
+using slab_value_ptr = value_ptr< T, detail::default_clone<T>, slab_delete<T> >;
+
+namespace detail {
+
+// holds the caller's reference to a slab under construction:
+
+template< class T >
+struct slab_guard
+{
+    slab_header * slab;
+    ~slab_guard() { if ( slab ) slab_block<T>::release( slab ); }
+};
+
+} // namespace detail
+
+// clone the content of the value_ptr-s in [first, last) into one slab and
+// write the resulting slab_value_ptr-s to out, empty ones stay empty:
+
+template< class ForwardIt, class OutputIt >
+OutputIt clone_range( ForwardIt first, ForwardIt last, OutputIt out )
+{
+    typedef typename std::iterator_traits<ForwardIt>::value_type::element_type T;
+    typedef std::unique_ptr< T, slab_delete<T> > slab_ptr;
+
+    std::size_t size = 0;
+
+    for ( ForwardIt pos = first; pos != last; ++pos )
+    {
+        if ( *pos ) ++size;
+    }
+
+    detail::slab_guard<T> guard = { size > 0 ? detail::slab_block<T>::allocate( size, 1 ) : nullptr };
+
+    T * next = guard.slab ? detail::slab_block<T>::first( guard.slab ) : nullptr;
+
+    for ( ; first != last; ++first, ++out )
+    {
+        if ( *first )
+        {
+            ::new( static_cast<void *>( next ) ) T( **first );
+            detail::slab_block<T>::acquire( guard.slab );
+            *out = slab_value_ptr<T>( slab_ptr( next++, slab_delete<T>( guard.slab ) ) );
+        }
+        else
+        {
+            *out = slab_value_ptr<T>();
+        }
+    }
+    return out;
+}
+
+// Compaction of a tree of slab_value_ptr-s into traversal order:
+
+// Children of a node are enumerated via an unqualified call
+// visit_children( node, f ), found by argument-dependent lookup, that calls
+// f( link ) for each slab_value_ptr<T> link of the node. Types without
+// visit_children() have no children.
+
+enum class compact_layout { dfs, bfs, veb };
+
+namespace detail {
+
+template< class T >
+struct collect_children
+{
+    std::vector<T *> & children;
+
+    template< class Link >
+    void operator()( Link & link ) const
+    {
+        nsvp_static_assert( ( std::is_same<Link, slab_value_ptr<T> >::value ), "compact() requires children of type slab_value_ptr<T>" );
+
+        if ( link ) children.push_back( link.get() );
+    }
+};
+
+template< class T >
+inline void children_of( T & node, std::vector<T *> & children )
+{
+    children.clear();
+    collect_children<T> f = { children };
+    visit_children_of( node, f, 0 );
+}
+
+template< class T >
+inline std::size_t tree_height( T * root )
+{
+    std::vector< std::pair<T *, std::size_t> > stack( 1, std::make_pair( root, std::size_t( 1 ) ) );
+    std::vector<T *> children;
+    std::size_t height = 0;
+
+    while ( ! stack.empty() )
+    {
+        std::pair<T *, std::size_t> top = stack.back(); stack.pop_back();
+        if ( top.second > height )
+            height = top.second;
+
+        children_of( *top.first, children );
+        for ( T * child : children )
+            stack.push_back( std::make_pair( child, top.second + 1 ) );
+    }
+    return height;
+}
+
+template< class T >
+inline void order_dfs( T * root, std::vector<T *> & order )
+{
+    std::vector<T *> stack( 1, root );
+    std::vector<T *> children;
+
+    while ( ! stack.empty() )
+    {
+        T * node = stack.back(); stack.pop_back();
+        order.push_back( node );
+
+        children_of( *node, children );
+        stack.insert( stack.end(), children.rbegin(), children.rend() );
+    }
+}
+
+template< class T >
+inline void order_bfs( T * root, std::vector<T *> & order )
+{
+    std::vector<T *> children;
+
+    order.push_back( root );
+
+    for ( std::size_t head = 0; head != order.size(); ++head )
+    {
+        children_of( *order[head], children );
+        order.insert( order.end(), children.begin(), children.end() );
+    }
+}
+
+// nodes at given depth below root, left to right:
+
+template< class T >
+inline void nodes_at_depth( T * root, std::size_t depth, std::vector<T *> & result )
+{
+    std::vector< std::pair<T *, std::size_t> > stack( 1, std::make_pair( root, std::size_t( 0 ) ) );
+    std::vector<T *> children;
+
+    while ( ! stack.empty() )
+    {
+        std::pair<T *, std::size_t> top = stack.back(); stack.pop_back();
+
+        if ( top.second == depth )
+        {
+            result.push_back( top.first );
+            continue;
+        }
+
+        children_of( *top.first, children );
+        for ( auto pos = children.rbegin(); pos != children.rend(); ++pos )
+            stack.push_back( std::make_pair( *pos, top.second + 1 ) );
+    }
+}
+
+// van Emde Boas order of the subtree of given height: the top half of the
+// levels first, then each subtree hanging below it; recursion depth is
+// logarithmic in the height:
+
+template< class T >
+inline void order_veb( T * root, std::size_t height, std::vector<T *> & order )
+{
+    if ( height <= 1 )
+    {
+        order.push_back( root );
+        return;
+    }
+
+    std::size_t const top = height / 2;
+    std::vector<T *> bottom;
+
+    order_veb( root, top, order );
+    nodes_at_depth( root, top, bottom );
+
+    for ( T * node : bottom )
+        order_veb( node, height - top, order );
+}
+
+template< class T >
+struct relink_children
+{
+    std::unordered_map<T const *, std::size_t> const & index;
+    slab_header * slab;
+
+    void operator()( slab_value_ptr<T> & link ) const
+    {
+        if ( ! link )
+            return;
+
+        // the moved-from original is deleted with the value_ptr it is swapped into:
+
+        link = slab_value_ptr<T>( std::unique_ptr< T, slab_delete<T> >(
+            slab_block<T>::first( slab ) + index.at( link.get() ), slab_delete<T>( slab ) ) );
+    }
+};
+
+} // namespace detail
+
+// move the nodes of the tree at root into a single slab in the given layout
+// order and release the original allocations, return the number of nodes:
+
+template< class T >
+std::size_t compact( slab_value_ptr<T> & root, compact_layout order = compact_layout::dfs )
+{
+    nsvp_static_assert( std::is_nothrow_move_constructible<T>::value, "compact() requires a nothrow move-constructible node type" );
+
+    if ( ! root )
+        return 0;
+
+    std::vector<T *> nodes;
+
+    switch ( order )
+    {
+        case compact_layout::dfs: detail::order_dfs( root.get(), nodes ); break;
+        case compact_layout::bfs: detail::order_bfs( root.get(), nodes ); break;
+        case compact_layout::veb: detail::order_veb( root.get(), detail::tree_height( root.get() ), nodes ); break;
+    }
+
+    std::size_t const size = nodes.size();
+    std::unordered_map<T const *, std::size_t> index;
+
+    index.reserve( size );
+    for ( std::size_t i = 0; i != size; ++i )
+        index[ nodes[i] ] = i;
+
+    // one reference per node, held by the link that is redirected to it:
+
+    detail::slab_header * const slab = detail::slab_block<T>::allocate( size, size );
+    T * const block = detail::slab_block<T>::first( slab );
+
+    // move the nodes, their links still refer to the moved-from originals:
+
+    for ( std::size_t i = 0; i != size; ++i )
+        ::new( static_cast<void *>( block + i ) ) T( std::move( *nodes[i] ) );
+
+    // redirect the links into the slab:
+
+    detail::relink_children<T> relink = { index, slab };
+
+    for ( std::size_t i = 0; i != size; ++i )
+        detail::visit_children_of( block[i], relink, 0 );
+
+    relink( root );
+
+    return size;
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_SLAB_LITE_HPP
@@ -0,0 +1,507 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: spillable_value_ptr and spill_manager (POSIX).
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_SPILL_LITE_HPP
+#define NONSTD_VALUE_PTR_SPILL_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <cstddef>
+# include <cstdio>
+# include <cstring>
+# include <list>
+# include <mutex>
+# include <new>
+# include <unordered_map>
+# include <vector>
+#endif
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+# include <cerrno>
+# include <unistd.h>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+
+// Spillable storage, content evicted to a temporary file under a memory budget:
+
+// Process-wide manager of the content of all spillable_value_ptr-s. When the
+// resident content exceeds the budget, the least recently used content that
+// is not pinned is written to an anonymous temporary file and its memory
+// released; it is read back when pinned again. The manager is never destroyed:
+
+class spill_manager
+{
+public:
+    struct entry;
+
+    static spill_manager & instance()
+    {
+        static spill_manager * manager = new spill_manager();
+        return *manager;
+    }
+
+    // the memory budget in bytes, unlimited by default:
+
+    void budget( std::size_t bytes )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        budget_ = bytes;
+        evict();
+    }
+
+    std::size_t budget() const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return budget_;
+    }
+
+    std::size_t resident_bytes() const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return resident_;
+    }
+
+    // Used by spillable_value_ptr:
+
+    entry * create( void const * bytes, std::size_t size )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        std::unique_ptr<entry> e( new entry( size ) );
+        std::unique_ptr<char, void(*)(void *)> memory( static_cast<char *>( ::operator new( size ) ), ::operator delete );
+
+        std::memcpy( memory.get(), bytes, size );
+
+        e->lru = lru_.insert( lru_.begin(), e.get() );
+        e->memory = memory.release();
+        resident_ += size;
+        evict();
+
+        return e.release();
+    }
+
+    void destroy( entry * e ) nsvp_noexcept
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        if ( e->memory )
+        {
+            ::operator delete( e->memory );
+            resident_ -= e->size;
+        }
+        if ( e->offset >= 0 )
+            free_[ e->size ].push_back( e->offset );
+
+        list_of( e ).erase( e->lru );
+        delete e;
+    }
+
+    // make the content resident and keep it so until unpin():
+
+    void * pin( entry * e )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        std::list<entry *> & from = list_of( e );
+
+        if ( ! e->memory )
+            fault_in( e );
+
+        ++e->pins;
+        held_.splice( held_.begin(), from, e->lru );
+        evict();
+
+        return e->memory;
+    }
+
+    void unpin( entry * e, bool modified ) nsvp_noexcept
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        e->dirty = e->dirty || modified;
+
+        if ( --e->pins == 0 )
+            lru_.splice( lru_.begin(), held_, e->lru );
+
+        evict();
+    }
+
+    bool resident( entry const * e ) const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return e->memory != nullptr;
+    }
+
+    struct entry
+    {
+        explicit entry( std::size_t n )
+        : size( n ), memory( nullptr ), offset( -1 ), pins( 0 ), dirty( true ), lru()
+        {}
+
+        std::size_t size;
+        void * memory;
+        ::off_t offset;     // in the file, -1 if none
+        std::size_t pins;
+        bool dirty;         // file copy absent or outdated
+        std::list<entry *>::iterator lru;
+    };
+
+private:
+    spill_manager()
+    : mutex_()
+    , budget_( std::size_t( -1 ) )
+    , resident_( 0 )
+    , end_( 0 )
+    , fd_( -1 )
+    , lru_()
+    , held_()
+    , free_()
+    {}
+
+    // the list an entry is on: lru_ if it can be spilled, held_ if it is
+    // pinned or already spilled; entries move between them via splice():
+
+    std::list<entry *> & list_of( entry const * e ) nsvp_noexcept
+    {
+        return e->memory && e->pins == 0 ? lru_ : held_;
+    }
+
+    // spill unpinned content, least recently unpinned first, until within
+    // budget; content that cannot be written stays resident:
+
+    void evict() nsvp_noexcept
+    {
+        for ( std::list<entry *>::iterator it = lru_.end(); resident_ > budget_ && it != lru_.begin(); )
+        {
+            entry * e = *--it;
+
+            if ( ! e->dirty || write_out( e ) )
+            {
+                std::list<entry *>::iterator const spilled = it++;
+
+                held_.splice( held_.begin(), lru_, spilled );
+                ::operator delete( e->memory );
+                e->memory = nullptr;
+                resident_ -= e->size;
+            }
+        }
+    }
+
+    bool write_out( entry * e ) nsvp_noexcept
+    {
+        if ( fd_ < 0 )
+        {
+            std::FILE * file = std::tmpfile();
+
+            if ( ! file )
+                return false;
+
+            fd_ = ::fileno( file );
+        }
+
+        if ( e->offset < 0 )
+        {
+            std::vector< ::off_t > & slots = free_[ e->size ];
+
+            if ( slots.empty() )
+            {
+                e->offset = end_;
+                end_ += static_cast< ::off_t >( e->size );
+            }
+            else
+            {
+                e->offset = slots.back();
+                slots.pop_back();
+            }
+        }
+
+        char const * p = static_cast<char const *>( e->memory );
+
+        for ( std::size_t done = 0; done < e->size; )
+        {
+            ::ssize_t n = ::pwrite( fd_, p + done, e->size - done, e->offset + static_cast< ::off_t >( done ) );
+
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 )
+                return false;
+
+            done += static_cast<std::size_t>( n );
+        }
+
+        e->dirty = false;
+        return true;
+    }
+
+    void fault_in( entry * e )
+    {
+        std::unique_ptr<char, void(*)(void *)> memory( static_cast<char *>( ::operator new( e->size ) ), ::operator delete );
+
+        for ( std::size_t done = 0; done < e->size; )
+        {
+            ::ssize_t n = ::pread( fd_, memory.get() + done, e->size - done, e->offset + static_cast< ::off_t >( done ) );
+
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n <= 0 )
+            {
+#if nsvp_CONFIG_NO_EXCEPTIONS
+                assert( !"spill_manager: cannot read spilled content" );
+#else
+                throw std::runtime_error( "spill_manager: cannot read spilled content" );
+#endif
+            }
+            done += static_cast<std::size_t>( n );
+        }
+
+        e->memory = memory.release();
+        resident_ += e->size;
+    }
+
+    mutable std::mutex mutex_;
+    std::size_t budget_;
+    std::size_t resident_;
+    ::off_t end_;
+    int fd_;
+    std::list<entry *> lru_;                                    // resident and unpinned, most recent first
+    std::list<entry *> held_;                                   // pinned or spilled
+    std::unordered_map< std::size_t, std::vector< ::off_t > > free_;   // file slots by size
+};
+
+// access to the content of a spillable_value_ptr that keeps it resident;
+// U is T for modifying access, T const otherwise:
+
+template< class U >
+class spill_pin
+{
+public:
+    typedef U   element_type;
+    typedef U * pointer;
+    typedef U & reference;
+
+    spill_pin( spill_manager::entry * e )
+    : entry_( e )
+    , ptr_( e ? static_cast<pointer>( spill_manager::instance().pin( e ) ) : nullptr )
+    {}
+
+    spill_pin( spill_pin && other ) nsvp_noexcept
+    : entry_( other.entry_ )
+    , ptr_( other.ptr_ )
+    {
+        other.entry_ = nullptr;
+        other.ptr_   = nullptr;
+    }
+
+    ~spill_pin()
+    {
+        if ( entry_ )
+            spill_manager::instance().unpin( entry_, ! std::is_const<U>::value );
+    }
+
+    spill_pin( spill_pin const & ) = delete;
+    spill_pin & operator=( spill_pin const & ) = delete;
+    spill_pin & operator=( spill_pin && ) = delete;
+
+    pointer get() const nsvp_noexcept
+    {
+        return ptr_;
+    }
+
+    reference operator*() const
+    {
+        assert( ptr_ != nullptr ); return *ptr_;
+    }
+
+    pointer operator->() const nsvp_noexcept
+    {
+        assert( ptr_ != nullptr ); return ptr_;
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return ptr_ != nullptr;
+    }
+
+private:
+    spill_manager::entry * entry_;
+    pointer ptr_;
+};
+
+// value_ptr-like holder of a trivially copyable T whose content may be spilled
+// to a file under the budget of spill_manager. The content is accessed via a
+// pin() guard, or copied out via load():
+
+template< class T >
+class spillable_value_ptr
+{
+public:
+    nsvp_static_assert( std::is_trivially_copyable<T>::value, "spillable_value_ptr requires a trivially copyable type" );
+    nsvp_static_assert( alignof( T ) <= alignof( std::max_align_t ), "spillable_value_ptr does not support over-aligned types" );
+
+    typedef T element_type;
+
+    // Lifetime
+
+    spillable_value_ptr() nsvp_noexcept
+    : entry_( nullptr )
+    {}
+
+    spillable_value_ptr( std::nullptr_t ) nsvp_noexcept
+    : entry_( nullptr )
+    {}
+
+    spillable_value_ptr( element_type const & value )
+    : entry_( spill_manager::instance().create( &value, sizeof( T ) ) )
+    {}
+
+    template< class... Args
+        nsvp_REQUIRES_T(
+            std::is_constructible<T, Args&&...>::value )
+    >
+    explicit spillable_value_ptr( nonstd_lite_in_place_t(T), Args&&... args )
+    : entry_( nullptr )
+    {
+        T const value( std::forward<Args>(args)...);
+        entry_ = spill_manager::instance().create( &value, sizeof( T ) );
+    }
+
+    spillable_value_ptr( spillable_value_ptr const & other )
+    : entry_( nullptr )
+    {
+        if ( other )
+        {
+            spill_pin<T const> pin( other.entry_ );
+            entry_ = spill_manager::instance().create( pin.get(), sizeof( T ) );
+        }
+    }
+
+    spillable_value_ptr( spillable_value_ptr && other ) nsvp_noexcept
+    : entry_( other.entry_ )
+    {
+        other.entry_ = nullptr;
+    }
+
+    ~spillable_value_ptr()
+    {
+        reset();
+    }
+
+    spillable_value_ptr & operator=( spillable_value_ptr const & rhs )
+    {
+        spillable_value_ptr( rhs ).swap( *this );
+        return *this;
+    }
+
+    spillable_value_ptr & operator=( spillable_value_ptr && rhs ) nsvp_noexcept
+    {
+        spillable_value_ptr( std::move( rhs ) ).swap( *this );
+        return *this;
+    }
+
+    spillable_value_ptr & operator=( std::nullptr_t ) nsvp_noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    spillable_value_ptr & operator=( element_type const & value )
+    {
+        spillable_value_ptr( value ).swap( *this );
+        return *this;
+    }
+
+    // Observers:
+
+    spill_pin<T> pin()
+    {
+        return spill_pin<T>( entry_ );
+    }
+
+    spill_pin<T const> pin() const
+    {
+        return spill_pin<T const>( entry_ );
+    }
+
+    // copy of the content:
+
+    element_type load() const
+    {
+        return *checked_pin();
+    }
+
+    explicit operator bool() const nsvp_noexcept
+    {
+        return has_value();
+    }
+
+    bool has_value() const nsvp_noexcept
+    {
+        return entry_ != nullptr;
+    }
+
+    // true if the content is in memory:
+
+    bool resident() const
+    {
+        return entry_ && spill_manager::instance().resident( entry_ );
+    }
+
+    // Modifiers:
+
+    void reset() nsvp_noexcept
+    {
+        if ( entry_ )
+            spill_manager::instance().destroy( entry_ );
+        entry_ = nullptr;
+    }
+
+    void swap( spillable_value_ptr & other ) nsvp_noexcept
+    {
+        std::swap( entry_, other.entry_ );
+    }
+
+private:
+    spill_pin<T const> checked_pin() const
+    {
+#if nsvp_CONFIG_NO_EXCEPTIONS
+        assert( has_value() );
+#else
+        if ( ! has_value() )
+        {
+            throw bad_value_access();
+        }
+#endif
+        return pin();
+    }
+
+    spill_manager::entry * entry_;
+};
+
+template< class T >
+inline void swap( spillable_value_ptr<T> & lhs, spillable_value_ptr<T> & rhs ) nsvp_noexcept
+{
+    lhs.swap( rhs );
+}
+
+#endif // nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_SPILL_LITE_HPP
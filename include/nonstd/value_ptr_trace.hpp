@@ -0,0 +1,480 @@
+//
+// Copyright 2017-2018 by Martin Moene
+//
+// https://github.com/martinmoene/value-ptr-lite
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// value-ptr-lite opt-in header: allocation trace recording and replay.
+
+#pragma once
+
+#ifndef NONSTD_VALUE_PTR_TRACE_LITE_HPP
+#define NONSTD_VALUE_PTR_TRACE_LITE_HPP
+
+#include "value_ptr.hpp"
+
+#if nsvp_CPP11_OR_GREATER
+# include <atomic>
+# include <chrono>
+# include <cstdint>
+# include <cstdio>
+# include <cstring>
+# include <mutex>
+# include <string>
+# include <unordered_map>
+# include <vector>
+#endif
+
+namespace nonstd { namespace vptr {
+
+#if nsvp_CPP11_OR_GREATER
+
+// Allocation traces of value_ptr-s, to replay against other allocators:
+//
+// trace_clone and trace_delete wrap a cloner and a deleter. While a trace is
+// started via alloc_trace::start(), they append a record per clone and per
+// delete to it. A trace starts with an alloc_trace_header, followed by the
+// records in the order of the operations, in host byte order. The first
+// record of a type in a trace is preceded by a record of op type_name,
+// followed by the name of the type, of size bytes. Records are appended
+// under a lock, so that the clone and delete of an address appear in the
+// order they occurred in.
+
+enum class alloc_trace_op : std::uint8_t { clone, destroy, type_name };
+
+struct alloc_trace_header
+{
+    char          magic[8];         // "nsvptrc"
+    std::uint32_t version;          // 1
+    std::uint32_t record_size;      // sizeof( alloc_trace_record )
+};
+
+struct alloc_trace_record
+{
+    std::uint64_t  time;            // nanoseconds since start()
+    std::uint64_t  address;         // of the object
+    std::uint32_t  size;            // sizeof object type, or length of type name
+    std::uint16_t  type;            // index of the type, in order of first use
+    std::uint8_t   thread;          // index of the thread, in order of first use, at most 255
+    alloc_trace_op op;
+};
+
+namespace detail {
+
+class alloc_trace_log
+{
+public:
+    // records are written to the file in blocks of about this size:
+
+    static std::size_t const block = 64 * 1024;
+
+    // never destroyed, so that value_ptr-s can be traced to the end:
+
+    static alloc_trace_log & instance()
+    {
+        static alloc_trace_log * log = new alloc_trace_log();
+        return *log;
+    }
+
+    bool active() const nsvp_noexcept
+    {
+        return active_.load( std::memory_order_acquire );
+    }
+
+    bool start( std::FILE * out, bool owned )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        if ( out_ || ! out )
+            return false;
+
+        alloc_trace_header const header = { { 'n', 's', 'v', 'p', 't', 'r', 'c', '\0' }, 1, sizeof( alloc_trace_record ) };
+
+        if ( std::fwrite( &header, sizeof header, 1, out ) != 1 )
+            return false;
+
+        buffer_.clear();
+        buffer_.reserve( 2 * block );
+        emitted_.clear();
+
+        out_   = out;
+        owned_ = owned;
+        good_  = true;
+        start_ = std::chrono::steady_clock::now();
+        active_.store( true, std::memory_order_release );
+        return true;
+    }
+
+    bool stop()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        if ( ! out_ )
+            return false;
+
+        active_.store( false, std::memory_order_release );
+        flush();
+
+        bool const closed = owned_ ? std::fclose( out_ ) == 0 : std::fflush( out_ ) == 0;
+
+        out_ = nsvp_nullptr;
+        return good_ && closed;
+    }
+
+    void record( alloc_trace_op op, void const * ptr, std::size_t size, std::uint16_t type, char const * name )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        if ( ! out_ )
+            return;
+
+        std::uint64_t const time = static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_ ).count() );
+
+        if ( emitted_.size() <= type )
+            emitted_.resize( type + 1u );
+
+        if ( ! emitted_[ type ] )
+        {
+            std::size_t const length = std::strlen( name );
+
+            append( make_record( alloc_trace_op::type_name, time, 0, length, type ) );
+            buffer_.insert( buffer_.end(), name, name + length );
+            emitted_[ type ] = true;
+        }
+
+        append( make_record( op, time, reinterpret_cast<std::uintptr_t>( ptr ), size, type ) );
+
+        if ( buffer_.size() >= block )
+            flush();
+    }
+
+private:
+    alloc_trace_log()
+    : mutex_(), active_( false ), out_( nsvp_nullptr ), owned_( false ), good_( true ), start_(), buffer_(), emitted_()
+    {}
+
+    static alloc_trace_record make_record( alloc_trace_op op, std::uint64_t time, std::uint64_t address, std::size_t size, std::uint16_t type ) nsvp_noexcept
+    {
+        alloc_trace_record r = { time, address, static_cast<std::uint32_t>( size ), type, thread_index(), op };
+        return r;
+    }
+
+    // index of the current thread, in order of first use, saturating:
+
+    static std::uint8_t thread_index() nsvp_noexcept
+    {
+        static std::atomic<unsigned> next( 0 );
+        static thread_local unsigned const index = next++;
+        return static_cast<std::uint8_t>( index < 255 ? index : 255 );
+    }
+
+    void append( alloc_trace_record const & r )
+    {
+        unsigned char const * p = reinterpret_cast<unsigned char const *>( &r );
+        buffer_.insert( buffer_.end(), p, p + sizeof r );
+    }
+
+    void flush()
+    {
+        if ( ! buffer_.empty() && std::fwrite( buffer_.data(), 1, buffer_.size(), out_ ) != buffer_.size() )
+            good_ = false;
+
+        buffer_.clear();
+    }
+
+    std::mutex mutex_;
+    std::atomic<bool> active_;
+    std::FILE * out_;
+    bool owned_;
+    bool good_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<unsigned char> buffer_;
+    std::vector<bool> emitted_;
+};
+
+inline std::uint16_t next_alloc_trace_type() nsvp_noexcept
+{
+    static std::atomic<std::uint16_t> next( 0 );
+    return next++;
+}
+
+template< class T >
+inline std::uint16_t alloc_trace_type() nsvp_noexcept
+{
+    static std::uint16_t const index = next_alloc_trace_type();
+    return index;
+}
+
+template< class T >
+inline void trace_event( alloc_trace_op op, T const * ptr )
+{
+    alloc_trace_log & log = alloc_trace_log::instance();
+
+    if ( ! ptr || ! log.active() )
+        return;
+
+    log.record( op, ptr, sizeof( T ), alloc_trace_type<T>(), type_name_c_str<T>() );
+}
+
+} // namespace detail
+
+// start and stop recording of trace_clone and trace_delete, one trace at a time:
+
+struct alloc_trace
+{
+    // trace into the file at path, which is created or truncated:
+
+    static bool start( char const * path )
+    {
+        std::FILE * out = std::fopen( path, "wb" );
+
+        if ( ! out )
+            return false;
+
+        if ( detail::alloc_trace_log::instance().start( out, true ) )
+            return true;
+
+        std::fclose( out );
+        return false;
+    }
+
+    // trace into out, which stop() flushes, but does not close:
+
+    static bool start( std::FILE * out )
+    {
+        return detail::alloc_trace_log::instance().start( out, false );
+    }
+
+    // write the remaining records, return true if all were written:
+
+    static bool stop()
+    {
+        return detail::alloc_trace_log::instance().stop();
+    }
+
+    static bool active() nsvp_noexcept
+    {
+        return detail::alloc_trace_log::instance().active();
+    }
+};
+
+// cloner that records its clones while a trace is active:
+
+template< class T, class Cloner = detail::default_clone<T> >
+struct trace_clone : Cloner
+{
+    template< class... Args >
+    auto operator()( Args &&... args ) const
+        -> decltype( std::declval<Cloner const &>()( std::forward<Args>( args )... ) )
+    {
+        T * result = Cloner::operator()( std::forward<Args>( args )... );
+        detail::trace_event( alloc_trace_op::clone, result );
+        return result;
+    }
+};
+
+// deleter that records its deletes while a trace is active:
+
+template< class T, class Deleter = detail::default_delete<T> >
+struct trace_delete : Deleter
+{
+    void operator()( T * ptr ) const
+    {
+        detail::trace_event( alloc_trace_op::destroy, ptr );
+        Deleter::operator()( ptr );
+    }
+};
+
+template< class T >
+using traced_value_ptr = value_ptr< T, trace_clone<T>, trace_delete<T> >;
+
+// a trace read back, with the type_name records turned into the type table:
+
+struct alloc_trace_data
+{
+    std::vector<std::string>        types;      // by type index
+    std::vector<alloc_trace_record> records;    // clones and deletes, in order
+};
+
+// read a trace written via alloc_trace; on failure, data is empty:
+
+inline bool load_alloc_trace( std::FILE * in, alloc_trace_data & data )
+{
+    data = alloc_trace_data();
+
+    alloc_trace_header header;
+
+    if ( std::fread( &header, sizeof header, 1, in ) != 1
+        || std::memcmp( header.magic, "nsvptrc", 8 ) != 0
+        || header.version != 1
+        || header.record_size != sizeof( alloc_trace_record ) )
+        return false;
+
+    alloc_trace_record r;
+    std::size_t n = 0;
+
+    while ( ( n = std::fread( &r, 1, sizeof r, in ) ) == sizeof r )
+    {
+        if ( r.op == alloc_trace_op::type_name && r.size <= 64 * 1024 )
+        {
+            std::string name( r.size, '\0' );
+
+            if ( r.size > 0 && std::fread( &name[0], 1, r.size, in ) != r.size )
+                break;
+
+            if ( data.types.size() <= r.type )
+                data.types.resize( r.type + 1u );
+
+            data.types[ r.type ] = name;
+        }
+        else if ( r.op == alloc_trace_op::clone || r.op == alloc_trace_op::destroy )
+        {
+            data.records.push_back( r );
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if ( n == 0 && std::feof( in ) )
+        return true;
+
+    data = alloc_trace_data();
+    return false;
+}
+
+inline bool load_alloc_trace( char const * path, alloc_trace_data & data )
+{
+    std::FILE * in = std::fopen( path, "rb" );
+
+    if ( ! in )
+    {
+        data = alloc_trace_data();
+        return false;
+    }
+
+    bool const result = load_alloc_trace( in, data );
+    std::fclose( in );
+    return result;
+}
+
+struct replay_result
+{
+    std::uint64_t clones;               // allocations made
+    std::uint64_t deletes;              // deallocations made
+    std::uint64_t unmatched;            // deletes of objects cloned before the trace started
+    std::uint64_t peak_bytes;           // maximum of bytes allocated and not yet deallocated
+    std::chrono::nanoseconds elapsed;   // time spent in the replay loop
+};
+
+// re-execute the clones and deletes of a trace in order, on the current
+// thread, via void * alloc.allocate( size ) and alloc.deallocate( p, size ),
+// which must return memory suitably aligned for any object. Each allocation
+// is written once, as a clone would. Deletes are matched to their clones
+// beforehand, so that the timed loop does no lookups. Objects that are still
+// live at the end of the trace are deallocated after timing:
+
+template< class Allocator >
+inline replay_result replay( alloc_trace_data const & trace, Allocator & alloc )
+{
+    std::size_t const none = std::size_t( -1 );
+    std::vector<alloc_trace_record> const & records = trace.records;
+
+    std::vector<std::size_t> slot_of( records.size(), none );
+    std::size_t slots = 0;
+    {
+        std::unordered_map<std::uint64_t, std::size_t> live;
+        std::vector<std::size_t> free_slots;
+
+        for ( std::size_t i = 0; i != records.size(); ++i )
+        {
+            alloc_trace_record const & r = records[i];
+
+            if ( r.op == alloc_trace_op::clone )
+            {
+                if ( free_slots.empty() )
+                {
+                    slot_of[i] = slots++;
+                }
+                else
+                {
+                    slot_of[i] = free_slots.back();
+                    free_slots.pop_back();
+                }
+                live[ r.address ] = slot_of[i];
+            }
+            else
+            {
+                auto const pos = live.find( r.address );
+
+                if ( pos == live.end() )
+                    continue;
+
+                slot_of[i] = pos->second;
+                free_slots.push_back( pos->second );
+                live.erase( pos );
+            }
+        }
+    }
+
+    std::vector<void *>      ptrs ( slots, nsvp_nullptr );
+    std::vector<std::size_t> sizes( slots, 0 );
+
+    replay_result result = { 0, 0, 0, 0, std::chrono::nanoseconds( 0 ) };
+    std::uint64_t bytes = 0;
+
+    std::chrono::steady_clock::time_point const begin = std::chrono::steady_clock::now();
+
+    for ( std::size_t i = 0; i != records.size(); ++i )
+    {
+        alloc_trace_record const & r = records[i];
+        std::size_t const slot = slot_of[i];
+
+        if ( r.op == alloc_trace_op::clone )
+        {
+            void * p = alloc.allocate( r.size );
+            std::memset( p, 0, r.size );
+
+            ptrs [ slot ] = p;
+            sizes[ slot ] = r.size;
+
+            ++result.clones;
+            bytes += r.size;
+            result.peak_bytes = bytes > result.peak_bytes ? bytes : result.peak_bytes;
+        }
+        else if ( slot == none )
+        {
+            ++result.unmatched;
+        }
+        else
+        {
+            alloc.deallocate( ptrs[ slot ], sizes[ slot ] );
+            ptrs[ slot ] = nsvp_nullptr;
+
+            ++result.deletes;
+            bytes -= sizes[ slot ];
+        }
+    }
+
+    result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - begin );
+
+    for ( std::size_t slot = 0; slot != slots; ++slot )
+        if ( ptrs[ slot ] )
+            alloc.deallocate( ptrs[ slot ], sizes[ slot ] );
+
+    return result;
+}
+
+#endif // nsvp_CPP11_OR_GREATER
+
+} // namespace vptr
+
+using namespace vptr;
+
+} // namespace nonstd
+
+#endif // NONSTD_VALUE_PTR_TRACE_LITE_HPP
@@ -30,7 +30,12 @@ CASE( "value-ptr-lite version" "[.value-ptr][.version]" )
 CASE( "value-ptr configuration" "[.value-ptr][.config]" )
 {
     nsvp_PRESENT( nsvp_CONFIG_COMPARE_POINTERS );
+    nsvp_PRESENT( nsvp_CONFIG_HASH_BYTES );
     nsvp_PRESENT( nsvp_CONFIG_NO_EXCEPTIONS );
+    nsvp_PRESENT( nsvp_CONFIG_STATS );
+    nsvp_PRESENT( nsvp_CONFIG_USDT_PROBES );
+    nsvp_PRESENT( nsvp_CONFIG_COPY_AUDIT );
+    nsvp_PRESENT( nsvp_CONFIG_COPY_AUDIT_SAMPLE );
     nsvp_PRESENT( nsvp_CPLUSPLUS );
 }
 
@@ -11,6 +11,19 @@
 #define value_ptr_lite_T_INCLUDED
 
 #include "nonstd/value_ptr.hpp"
+#include "nonstd/value_ptr_clone.hpp"
+#include "nonstd/value_ptr_compact.hpp"
+#include "nonstd/value_ptr_compressed.hpp"
+#include "nonstd/value_ptr_footprint.hpp"
+#include "nonstd/value_ptr_hashed.hpp"
+#include "nonstd/value_ptr_interner.hpp"
+#include "nonstd/value_ptr_io.hpp"
+#include "nonstd/value_ptr_keyed.hpp"
+#include "nonstd/value_ptr_memfd.hpp"
+#include "nonstd/value_ptr_range.hpp"
+#include "nonstd/value_ptr_slab.hpp"
+#include "nonstd/value_ptr_spill.hpp"
+#include "nonstd/value_ptr_trace.hpp"
 
 // Compiler warning suppression for usage of lest:
 
@@ -38,6 +51,40 @@ inline std::ostream & operator<<( std::ostream & os, ::nonstd::value_ptr<T, Clon
     os << "[value_ptr: "; if (vp) os << *vp; else os << "[empty]"; return os << "]";
 }
 
+#if nsvp_CPP11_OR_GREATER
+template< typename T, class Cloner, class Deleter>
+inline std::ostream & operator<<( std::ostream & os, ::nonstd::hashed_value_ptr<T, Cloner, Deleter> const & vp )
+{
+    os << "[hashed_value_ptr: "; if (vp) os << *vp; else os << "[empty]"; return os << "]";
+}
+
+template< typename T, class KeyFn, std::size_t N, class Cloner, class Deleter>
+inline std::ostream & operator<<( std::ostream & os, ::nonstd::keyed_value_ptr<T, KeyFn, N, Cloner, Deleter> const & vp )
+{
+    os << "[keyed_value_ptr: "; if (vp) os << *vp; else os << "[empty]"; return os << "]";
+}
+
+template< typename T, class Pool >
+inline std::ostream & operator<<( std::ostream & os, ::nonstd::compact_value_ptr<T, Pool> const & vp )
+{
+    os << "[compact_value_ptr: "; if (vp) os << *vp; else os << "[empty]"; return os << "]";
+}
+
+#if nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+template< typename T >
+inline std::ostream & operator<<( std::ostream & os, ::nonstd::compressed_value_ptr<T> const & vp )
+{
+    os << "[compressed_value_ptr: "; if (vp) os << *vp; else os << "[empty]"; return os << "]";
+}
+#endif
+
+template< typename T >
+inline std::ostream & operator<<( std::ostream & os, ::nonstd::interned<T> const & ip )
+{
+    os << "[interned: "; if (ip) os << *ip; else os << "[empty]"; return os << "]";
+}
+#endif
+
 }}
 
 namespace lest {
@@ -13,6 +13,20 @@
 
 #include "value-ptr-main.t.hpp"
 
+#if nsvp_CPP11_OR_GREATER
+# include <algorithm>
+# include <iterator>
+# include <list>
+# include <set>
+# include <thread>
+# include <unordered_set>
+# include <vector>
+#endif
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+# include <cstdio>
+#endif
+
 using namespace nonstd;
 
 namespace {
@@ -305,6 +319,63 @@ CASE( "value_ptr: Allows to construct from pointer to value" )
     EXPECT( *a == 7 );
 }
 
+namespace adopt {
+
+// stateful deleter, counts deletions in the counter it refers to:
+
+struct CountingDelete
+{
+    int * count;
+
+    CountingDelete() : count( nsvp_nullptr ) {}
+    CountingDelete( int * c ) : count( c ) {}
+
+    void operator()( int * ptr ) const { if ( ptr ) { ++*count; delete ptr; } }
+};
+}
+
+CASE( "value_ptr: Allows to adopt the content of a unique_ptr without cloning (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    std::unique_ptr<int> up( new int( 7 ) );
+    int * const p = up.get();
+
+    value_ptr<int> vp( std::move( up ) );
+
+    EXPECT(  vp.get() == p );
+    EXPECT( *vp       == 7 );
+    EXPECT( up.get() == nullptr );
+    EXPECT(( std::is_constructible< value_ptr<int>, std::unique_ptr<int> && >::value ));
+    EXPECT_NOT(( std::is_convertible< std::unique_ptr<int> &&, value_ptr<int> >::value ));
+#else
+    EXPECT( !!"value_ptr: unique_ptr adoption is not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to adopt the content of a unique_ptr with a stateful deleter (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace adopt;
+    typedef value_ptr<int, vptr::detail::default_clone<int>, CountingDelete> Value_ptr;
+
+    int count = 0;
+    {
+        Value_ptr a( std::unique_ptr<int, CountingDelete>( new int( 7 ), CountingDelete( &count ) ) );
+        Value_ptr b;
+
+        EXPECT( a.get_deleter().count == &count );
+
+        b.swap( a );
+
+        EXPECT( b.get_deleter().count == &count );
+        EXPECT( 0 == count );
+    }
+    EXPECT( 1 == count );
+#else
+    EXPECT( !!"value_ptr: unique_ptr adoption is not available (no C++11)" );
+#endif
+}
+
 // assignment:
 
 CASE( "value_ptr: Allows to assign nullptr to disengage (C++11)" )
@@ -678,509 +749,3333 @@ CASE( "value_ptr: Allows to construct via user-specified cloner with member data
     }}
 }
 
-// observers:
-
-struct Integer { int x; Integer(int v) : x(v) {} };
+#if nsvp_CPP11_OR_GREATER
+namespace clone_memo {
 
-CASE( "value_ptr: Allows to obtain pointer to value via operator->()" )
+struct Node
 {
-    SETUP( "" )
-    {
-        value_ptr<Integer> e( Integer( 42 ) );
+    static int live;
 
-    SECTION( "operator->() yields pointer to value (const)" )
-    {
-        EXPECT(  e->x == 42 );
-    }
+    int value;
+    memo_value_ptr<Node> left;
+    memo_value_ptr<Node> right;
 
-    SECTION( "operator->() yields pointer to value (non-const)" )
-    {
-        e->x = 7;
-        EXPECT(  e->x == 7 );
-    }}
+    Node( int v ) : value( v ), left(), right() { ++live; }
+    Node( Node const & other ) : value( other.value ), left( other.left ), right( other.right ) { ++live; }
+    ~Node() { --live; }
+};
+
+int Node::live = 0;
 }
+#endif
 
-CASE( "value_ptr: Allows to obtain value via operator*()" )
+CASE( "value_ptr: Allows to copy a DAG cloning each node once via clone_with() and memo_clone (C++11)" )
 {
-    SETUP( "" )
+#if nsvp_CPP11_OR_GREATER
+    using namespace clone_memo;
+    typedef memo_value_ptr<Node> Node_ptr;
     {
-        value_ptr<int> e( 42 );
+        Node_ptr root( Node( 1 ) );
+        {
+            Node_ptr shared( Node( 2 ) );
+            clone_context build;
+            clone_context::scope session( build );
 
-    SECTION( "operator*() yields value (const)" )
-    {
-        EXPECT( *e == 42 );
-    }
+            root->left  = shared;
+            root->right = shared;
+        }
 
-    SECTION( "operator*() yields value (non-const)" )
-    {
-        *e = 7;
-        EXPECT( *e == 7 );
-    }}
-}
+        EXPECT( root->left.get() == root->right.get() );
+        EXPECT( Node::live == 2 );
 
-CASE( "value_ptr: Allows to obtain moved-value via operator*()" )
-{
-}
+        clone_context ctx;
+        Node_ptr copy = root.clone_with( ctx );
 
-CASE( "value_ptr: Allows to obtain engaged state via operator bool()" )
-{
-    value_ptr<int> a;
-    value_ptr<int> b( 7 );
+        EXPECT( copy->value == 1 );
+        EXPECT( copy->left->value == 2 );
+        EXPECT( copy.get() != root.get() );
+        EXPECT( copy->left.get() != root->left.get() );
+        EXPECT( copy->left.get() == copy->right.get() );
+        EXPECT( ctx.size() == 0u );
+        EXPECT( clone_context::current() == nullptr );
+        EXPECT( Node::live == 4 );
 
-    EXPECT_NOT( a );
-    EXPECT(     b );
-}
+        root.reset();
 
-CASE( "value_ptr: Allows to obtain engaged state via has_value()" )
-{
-    value_ptr<int> a;
-    value_ptr<int> b( 7 );
+        EXPECT( Node::live == 2 );
+        EXPECT( copy->left->value == 2 );
 
-    EXPECT_NOT( a.has_value() );
-    EXPECT(     b.has_value() );
+        Node_ptr plain( copy );
+
+        EXPECT( plain->left.get() != plain->right.get() );
+        EXPECT( Node::live == 5 );
+    }
+    EXPECT( Node::live == 0 );
+#else
+    EXPECT( !!"value_ptr: clone_with() is not available (no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Allows to obtain value via value()" )
+CASE( "value_ptr: Allows to reuse a clone_context, that forgets its sources after each clone_with() (C++11)" )
 {
-    SETUP( "" )
+#if nsvp_CPP11_OR_GREATER
+    using namespace clone_memo;
+    typedef memo_value_ptr<Node> Node_ptr;
     {
-        value_ptr<int> e( 42 );
+        Node_ptr node( Node( 1 ) );
+        clone_context ctx;
 
-    SECTION( "value() yields value (const)" )
-    {
-        EXPECT( e.value() == 42 );
-    }
+        Node_ptr first = node.clone_with( ctx );
 
-    SECTION( "value() yields value (non-const)" )
-    {
-        e.value() = 7;
+        node->value = 2;
 
-        EXPECT( e.value() == 7 );
-    }}
+        Node_ptr second = node.clone_with( ctx );
+
+        EXPECT( first->value  == 1 );
+        EXPECT( second->value == 2 );
+        EXPECT( first.get() != second.get() );
+        EXPECT( ctx.size() == 0u );
+
+        {
+            clone_context::scope session( ctx );
+
+            Node_ptr third = node.clone_with( ctx );
+            Node_ptr fourth( node );
+
+            EXPECT( third.get() == fourth.get() );
+            EXPECT( ctx.size() == 1u );
+        }
+        EXPECT( ctx.size() == 0u );
+    }
+    EXPECT( Node::live == 0 );
+#else
+    EXPECT( !!"value_ptr: clone_with() is not available (no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Allows to obtain value or default via value_or()" )
+CASE( "value_ptr: Allows to copy via clone_with() with default cloner as a plain deep copy (C++11)" )
 {
-    SETUP( "" )
-    {
-        value_ptr<int> d;
-        value_ptr<int> e( 42 );
+#if nsvp_CPP11_OR_GREATER
+    value_ptr<int> a( 7 );
+    clone_context ctx;
 
-    SECTION( "value_or( 7 ) yields value for non-empty value_ptr" )
-    {
-        EXPECT( e.value_or( 7 ) == 42 );
-    }
+    value_ptr<int> b = a.clone_with( ctx );
 
-    SECTION( "value_or( 7 ) yields default for empty value_ptr" )
-    {
-        EXPECT( d.value_or( 7 ) == 7 );
-    }}
+    EXPECT( *b == 7 );
+    EXPECT(  b.get() != a.get() );
+    EXPECT(  ctx.size() == 0u );
+#else
+    EXPECT( !!"value_ptr: clone_with() is not available (no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Allows to obtain moved-default via value_or() (C++11)" )
+// observers:
+
+struct Integer { int x; Integer(int v) : x(v) {} };
+
+CASE( "clone_range: Allows to clone a range of value_ptr into a single slab (C++11)" )
 {
 #if nsvp_CPP11_OR_GREATER
-    S s( 7 );
-    value_ptr<S> d;
+    std::vector< value_ptr<int> > src;
 
-    EXPECT( s.state == value_move_constructed );
-    EXPECT( d.value_or( std::move(s) ).value == S(7).value );
-    EXPECT( s.state == moved_from );
+    src.push_back( value_ptr<int>( 1 ) );
+    src.push_back( value_ptr<int>(   ) );
+    src.push_back( value_ptr<int>( 2 ) );
+    src.push_back( value_ptr<int>( 3 ) );
+
+    std::vector< slab_value_ptr<int> > dst;
+
+    clone_range( src.begin(), src.end(), std::back_inserter( dst ) );
+
+    EXPECT( dst.size() == 4u );
+    EXPECT( *dst[0] == 1 );
+    EXPECT_NOT( dst[1] );
+    EXPECT( *dst[2] == 2 );
+    EXPECT( *dst[3] == 3 );
+
+    EXPECT( dst[2].get() == dst[0].get() + 1 );
+    EXPECT( dst[3].get() == dst[0].get() + 2 );
+    EXPECT( dst[3].get_deleter().owns( dst[0].get() ) );
 #else
-    EXPECT( !!"value_ptr: move-semantics are not available (no C++11)" );
+    EXPECT( !!"clone_range: slab cloning is not available (no C++11)" );
 #endif
 }
 
-CASE( "value_ptr: Throws bad_value_access at disengaged access" )
+CASE( "clone_range: Frees the slab with the last of its objects, a copy does not hold on to it (C++11)" )
 {
-    value_ptr<int>       vp;
-    value_ptr<int> const cvp;
+#if nsvp_CPP11_OR_GREATER
+    std::vector< value_ptr<int> > src( 3, value_ptr<int>( 7 ) );
+    std::vector< slab_value_ptr<int> > dst( 3 );
 
-    EXPECT_THROWS_AS(  vp.value(), bad_value_access );
-    EXPECT_THROWS_AS( cvp.value(), bad_value_access );
-}
+    clone_range( src.begin(), src.end(), dst.begin() );
 
-// modifiers:
+    EXPECT( dst[0].get_deleter().use_count() == 3u );
 
-CASE( "value_ptr: Allows to release its content" )
-{
-    value_ptr<int> a = 7;
+    slab_value_ptr<int> copy( dst[0] );
 
-    int * ap = a.release();
+    EXPECT( dst[0].get_deleter().use_count() == 3u );
+    EXPECT( copy.get_deleter().use_count() == 0u );
 
-    EXPECT_NOT(  a       );
-    EXPECT(     *ap == 7 ); delete ap;
+    dst[0].reset();
+    dst[1] = 42;
+
+    EXPECT( dst[2].get_deleter().use_count() == 1u );
+    EXPECT( dst[1].get_deleter().use_count() == 0u );
+
+    dst[2].reset();
+
+    EXPECT( *copy == 7 );
+    EXPECT( sizeof( slab_value_ptr<int> ) == 2 * sizeof( void * ) );
+#else
+    EXPECT( !!"clone_range: slab cloning is not available (no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Allows to clear its content (reset)" )
+CASE( "clone_range: Allows to copy and assign slab_value_ptr-s independent of their slab (C++11)" )
 {
-    value_ptr<int> a = 7;
+#if nsvp_CPP11_OR_GREATER
+    std::vector< value_ptr<int> > src( 3, value_ptr<int>( 7 ) );
+    std::vector< slab_value_ptr<int> > dst( 3 );
 
-    a.reset();
+    clone_range( src.begin(), src.end(), dst.begin() );
 
-    EXPECT_NOT( a );
+    slab_value_ptr<int> copy( dst[0] );
+
+    dst[1] = 42;
+    dst.clear();
+
+    EXPECT( *copy == 7 );
+    EXPECT_NOT( copy.get_deleter().owns( copy.get() ) );
+    EXPECT( copy.get_deleter().use_count() == 0u );
+#else
+    EXPECT( !!"clone_range: slab cloning is not available (no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Allows to replace its content (reset)" )
+#if nsvp_CPP11_OR_GREATER
+namespace compact_tree {
+
+struct Node
 {
-    value_ptr<int> a;
-    int * ap = new int( 7 );
+    int value;
+    slab_value_ptr<Node> left;
+    slab_value_ptr<Node> right;
 
-    a.reset( ap );
+    Node( int v ) : value( v ), left(), right() {}
+};
 
-    EXPECT(  a      );
-    EXPECT( *a == 7 );
+template< class F >
+void visit_children( Node & node, F & f )
+{
+    f( node.left );
+    f( node.right );
 }
 
-// swap:
+// complete binary tree, values in depth-first order:
 
-CASE( "value_ptr: Allows to swap with other value_ptr (member)" )
+inline slab_value_ptr<Node> make_tree( int height, int & next )
+{
+    if ( height == 0 )
+        return slab_value_ptr<Node>();
+
+    slab_value_ptr<Node> node( Node( next++ ) );
+    node->left  = make_tree( height - 1, next );
+    node->right = make_tree( height - 1, next );
+    return node;
+}
+
+inline int sum( slab_value_ptr<Node> const & node )
+{
+    return node ? node->value + sum( node->left ) + sum( node->right ) : 0;
+}
+}
+#endif
+
+CASE( "compact: Allows to lay out a tree contiguously in depth-first and breadth-first order (C++11)" )
 {
+#if nsvp_CPP11_OR_GREATER
+    using namespace compact_tree;
+
     SETUP( "" )
     {
-        value_ptr<int> d1;
-        value_ptr<int> d2;
-        value_ptr<int> e1( 42 );
-        value_ptr<int> e2( 7 );
+        int next = 0;
+        slab_value_ptr<Node> root = make_tree( 3, next );
+        Node * const original = root.get();
 
-    SECTION( "swap disengaged with disengaged value_ptr" )
+    SECTION( "depth-first" )
     {
-        d1.swap( d2 );
-
-        EXPECT( !d1 );
-        EXPECT(  d1.get() == d2.get() );
-    }
+        EXPECT( compact( root, compact_layout::dfs ) == 7u );
 
-    SECTION( "swap engaged with engaged value_ptr" )
-    {
-        e1.swap( e2 );
+        Node * const base = root.get();
 
-        EXPECT(  e1  );
-        EXPECT(  e2 );
-        EXPECT( *e1 == 7 );
-        EXPECT( *e2 == 42 );
-        EXPECT(  e1.get() != e2.get() );
+        EXPECT( root->left.get()        == base + 1 );
+        EXPECT( root->left->left.get()  == base + 2 );
+        EXPECT( root->right.get()       == base + 4 );
+        EXPECT( sum( root ) == 21 );
     }
 
-    SECTION( "swap disengaged with engaged value_ptr" )
+    SECTION( "breadth-first" )
     {
-        d1.swap( e1 );
+        EXPECT( compact( root, compact_layout::bfs ) == 7u );
 
-        EXPECT(  d1 );
-        EXPECT( !e1 );
-        EXPECT( *d1 == 42 );
-        EXPECT(  d1.get() != e1.get() );
+        Node * const base = root.get();
+
+        EXPECT( root->left.get()        == base + 1 );
+        EXPECT( root->right.get()       == base + 2 );
+        EXPECT( root->left->left.get()  == base + 3 );
+        EXPECT( sum( root ) == 21 );
     }
 
-    SECTION( "swap engaged with disengaged value_ptr" )
+    SECTION( "original allocations released" )
     {
-        e1.swap( d1 );
+        compact( root );
 
-        EXPECT(  d1 );
-        EXPECT( !e1 );
-        EXPECT( *d1 == 42 );
-        EXPECT(  d1.get() != e1.get() );
+        EXPECT( root.get() != original );
+        EXPECT( root.get_deleter().owns( root->right->right.get() ) );
     }}
+#else
+    EXPECT( !!"compact: tree compaction is not available (no C++11)" );
+#endif
 }
 
-//
-// value_ptr non-member functions:
-//
-
-CASE( "value_ptr: Allows to swap with other value_ptr (non-member)" )
+CASE( "compact: Allows to lay out a tree contiguously in van Emde Boas order, keeping value semantics (C++11)" )
 {
-    SETUP( "" )
-    {
-        value_ptr<int> d1;
-        value_ptr<int> d2;
-        value_ptr<int> e1( 42 );
-        value_ptr<int> e2( 7 );
+#if nsvp_CPP11_OR_GREATER
+    using namespace compact_tree;
 
-    SECTION( "swap disengaged with disengaged value_ptr" )
-    {
-        swap( d1, d2 );
+    int next = 0;
+    slab_value_ptr<Node> root = make_tree( 4, next );
 
-        EXPECT( !d1 );
-        EXPECT(  d1.get() == d2.get() );
-    }
-    SECTION( "swap engaged with engaged value_ptr" )
-    {
-        swap( e1, e2 );
+    EXPECT( compact( root, compact_layout::veb ) == 15u );
 
-        EXPECT(  e1  );
-        EXPECT(  e2 );
-        EXPECT( *e1 == 7 );
-        EXPECT( *e2 == 42 );
-        EXPECT(  e2.get() != e1.get() );
-    }
+    Node * const base = root.get();
+
+    EXPECT( root->left.get()              == base + 1 );
+    EXPECT( root->right.get()             == base + 2 );
+    EXPECT( root->left->left.get()        == base + 3 );
+    EXPECT( root->left->left->left.get()  == base + 4 );
+    EXPECT( root->left->right.get()       == base + 6 );
+
+    slab_value_ptr<Node> copy( root );
+
+    root.reset();
+
+    EXPECT( sum( copy ) == 105 );
+#else
+    EXPECT( !!"compact: tree compaction is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact: Releases the slab with its last node, also while a copy of the tree lives on (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace compact_tree;
+
+    int next = 0;
+    slab_value_ptr<Node> root = make_tree( 3, next );
+
+    compact( root );
+
+    EXPECT( root.get_deleter().use_count() == 7u );
+
+    slab_value_ptr<Node> copy( root );
+
+    EXPECT( root.get_deleter().use_count() == 7u );
+    EXPECT( copy.get_deleter().use_count() == 0u );
+    EXPECT( copy->right->left.get_deleter().use_count() == 0u );
+
+    root->left.reset();
+
+    EXPECT( root.get_deleter().use_count() == 4u );
+
+    root.reset();
+
+    EXPECT( sum( copy ) == 21 );
+    EXPECT( sizeof( slab_value_ptr<Node> ) == 2 * sizeof( void * ) );
+#else
+    EXPECT( !!"compact: tree compaction is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace serial {
+
+struct Node
+{
+    std::string name;
+    int value;
+    std::vector< value_ptr<Node> > kids;
+
+    Node() : name(), value( 0 ), kids() {}
+    Node( std::string n, int v ) : name( n ), value( v ), kids() {}
+};
+
+template< class F >
+void visit_children( Node & node, F & f )
+{
+    for ( auto & kid : node.kids )
+        f( kid );
+}
+
+template< class Writer >
+void serialize_payload( Writer & writer, Node const & node )
+{
+    serialize_payload( writer, node.name );
+    serialize_payload( writer, node.value );
+    serialize_payload( writer, static_cast<std::uint32_t>( node.kids.size() ) );
+}
+
+template< class Reader >
+bool deserialize_payload( Reader & reader, Node & node )
+{
+    std::uint32_t count = 0;
+
+    if ( ! deserialize_payload( reader, node.name  )
+      || ! deserialize_payload( reader, node.value )
+      || ! deserialize_payload( reader, count ) )
+        return false;
+
+    node.kids.resize( count );
+    return true;
+}
+
+inline value_ptr<Node> make_tree()
+{
+    value_ptr<Node> root( Node( "root", 1 ) );
+
+    root->kids.push_back( value_ptr<Node>( Node( "left", 2 ) ) );
+    root->kids.push_back( value_ptr<Node>() );
+    root->kids.push_back( value_ptr<Node>( Node( "right", 3 ) ) );
+    root->kids[2]->kids.push_back( value_ptr<Node>( Node( std::string( 5000, 'x' ), 4 ) ) );
+    return root;
+}
+
+inline bool same( value_ptr<Node> const & a, value_ptr<Node> const & b )
+{
+    if ( ! a || ! b )
+        return ! a && ! b;
+
+    if ( a->name != b->name || a->value != b->value || a->kids.size() != b->kids.size() )
+        return false;
+
+    for ( std::size_t i = 0; i != a->kids.size(); ++i )
+        if ( ! same( a->kids[i], b->kids[i] ) )
+            return false;
+    return true;
+}
+}
+#endif
+
+CASE( "serialize: Allows to write and read a tree of value_ptr via a buffer (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace serial;
+
+    value_ptr<Node> root = make_tree();
+    buffer_writer writer;
+
+    EXPECT( serialize( writer, root ) );
+    EXPECT( serialize( writer, value_ptr<Node>() ) );
+    EXPECT( serialize( writer, value_ptr<int>( 42 ) ) );
+
+    buffer_reader reader( writer.bytes().data(), writer.bytes().size() );
+
+    value_ptr<Node> copy = deserialize<Node>( reader );
+    value_ptr<Node> empty( Node( "stale", 0 ) );
+
+    EXPECT( same( copy, root ) );
+    EXPECT( deserialize( reader, empty ) );
+    EXPECT( !empty );
+    EXPECT( *deserialize<int>( reader ) == 42 );
+    EXPECT( reader.good() );
+    EXPECT( reader.remaining() == 0u );
+#else
+    EXPECT( !!"serialize: serialization is not available (no C++11)" );
+#endif
+}
+
+CASE( "serialize: Reports truncated and corrupt input, and does not recurse (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace serial;
+
+    SETUP( "" ) {
+
+    buffer_writer writer;
+
+    SECTION( "truncated" )
+    {
+        serialize( writer, make_tree() );
+
+        buffer_reader reader( writer.bytes().data(), writer.bytes().size() - 1 );
+        value_ptr<Node> vp = make_tree();
+
+        EXPECT_NOT( deserialize( reader, vp ) );
+        EXPECT_NOT( reader.good() );
+        EXPECT( !vp );
+    }
+    SECTION( "corrupt tag" )
+    {
+        unsigned char const bytes[] = { 2 };
+        buffer_reader reader( bytes, sizeof bytes );
+
+        EXPECT( !deserialize<int>( reader ) );
+        EXPECT_NOT( reader.good() );
+    }
+    SECTION( "deep" )
+    {
+        value_ptr<Node> root( Node( "0", 0 ) );
+        Node * tail = root.get();
+
+        for ( int i = 1; i < 10000; ++i )
+        {
+            tail->kids.push_back( value_ptr<Node>( Node( "n", i ) ) );
+            tail = tail->kids.back().get();
+        }
+
+        serialize( writer, root );
+        buffer_reader reader( writer.bytes().data(), writer.bytes().size() );
+        value_ptr<Node> copy = deserialize<Node>( reader );
+
+        EXPECT( reader.good() );
+
+        Node const * node = copy.get();
+        int depth = 1;
+        for ( ; ! node->kids.empty(); ++depth )
+            node = node->kids.front().get();
+
+        EXPECT( depth == 10000 );
+        EXPECT( node->value == 9999 );
+    }
+    }
+#else
+    EXPECT( !!"serialize: serialization is not available (no C++11)" );
+#endif
+}
+
+CASE( "serialize: Allows to write and read a tree via a file descriptor (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace serial;
+
+    std::FILE * file = std::tmpfile();
+    int const fd = ::fileno( file );
+    value_ptr<Node> root = make_tree();
+
+    {
+        fd_writer writer( fd, 16 );
+
+        EXPECT( serialize( writer, root ) );
+        EXPECT( writer.flush() );
+    }
+
+    ::lseek( fd, 0, SEEK_SET );
+
+    fd_reader reader( fd, 7 );
+    value_ptr<Node> copy = deserialize<Node>( reader );
+
+    EXPECT( reader.good() );
+    EXPECT( same( copy, root ) );
+
+    std::fclose( file );
+#else
+    EXPECT( !!"serialize: fd_writer and fd_reader are not available (no POSIX or no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+namespace frozen {
+
+struct Node
+{
+    int value;
+    char tag[4];
+    value_ptr<Node> left;
+    value_ptr<Node> right;
+
+    Node( int v ) : value( v ), tag(), left(), right() { tag[0] = char( 'a' + v ); }
+};
+
+template< class F >
+void visit_children( Node & node, F & f )
+{
+    f( node.left );
+    f( node.right );
+}
+
+inline value_ptr<Node> make_tree( int height, int & next )
+{
+    if ( height == 0 )
+        return value_ptr<Node>();
+
+    value_ptr<Node> node( Node( next++ ) );
+    node->left  = make_tree( height - 1, next );
+    node->right = make_tree( height - 1, next );
+    return node;
+}
+
+inline int sum( value_ptr<Node> const & node )
+{
+    return node ? node->value + sum( node->left ) + sum( node->right ) : 0;
+}
+
+// temporary file, removed at end of scope:
+
+struct temp_path
+{
+    char path[32];
+
+    temp_path()
+    {
+        std::strcpy( path, "/tmp/nsvp-frozen-XXXXXX" );
+        ::close( ::mkstemp( path ) );
+    }
+
+    ~temp_path()
+    {
+        ::unlink( path );
+    }
+};
+}
+#endif
+
+CASE( "mmap_view: Allows to navigate a frozen tree in a read-only mapping (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace frozen;
+
+    temp_path file;
+    int next = 0;
+    value_ptr<Node> root = make_tree( 4, next );
+
+    EXPECT( freeze( root, file.path ) );
+
+    mmap_view<Node> view( file.path );
+
+    EXPECT( view.good() );
+    EXPECT( view.size() == 15u );
+    EXPECT( view.root().value == 0 );
+    EXPECT( view.root().tag[0] == 'a' );
+    EXPECT( view.root().left->left->value == 2 );
+    EXPECT( view.root().right->value == 8 );
+    EXPECT( view.root().left.get() == view.get() + 1 );
+    EXPECT( ! view.root().left->left->left->left );
+    EXPECT( view.get( view.get( view.root().left )->right )->value == 5 );
+    EXPECT( view.get( view.root().left ) == view.get() + 1 );
+
+    EXPECT( ( std::is_same< decltype( view.root() ), Node const & >::value ) );
+    EXPECT( ( std::is_same< decltype( view.get() ), Node const * >::value ) );
+    EXPECT( ( std::is_same< decltype( view.get( view.root().left ) ), Node const * >::value ) );
+#else
+    EXPECT( !!"mmap_view: frozen trees are not available (no POSIX or no C++11)" );
+#endif
+}
+
+CASE( "mmap_view: Allows to thaw a frozen tree into a heap copy (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace frozen;
+
+    temp_path file;
+    int next = 0;
+    value_ptr<Node> root = make_tree( 3, next );
+
+    EXPECT( freeze( root, file.path ) );
+
+    value_ptr<Node> copy;
+    {
+        mmap_view<Node> view( file.path );
+        copy = thaw( view );
+    }
+    copy->right->value = 100;
+
+    EXPECT( sum( copy ) == sum( root ) - 4 + 100 );
+#else
+    EXPECT( !!"mmap_view: frozen trees are not available (no POSIX or no C++11)" );
+#endif
+}
+
+CASE( "mmap_view: Rejects a missing, truncated or foreign file, and maps an empty tree (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace frozen;
+
+    temp_path file;
+    int next = 0;
+
+    EXPECT( freeze( make_tree( 3, next ), file.path ) );
+    EXPECT( ::truncate( file.path, 100 ) == 0 );
+    EXPECT_NOT( mmap_view<Node>( file.path ).good() );
+    EXPECT_NOT( mmap_view<Node>( "/nonexistent/nsvp-frozen" ).good() );
+    EXPECT_NOT( mmap_view<int>( file.path ).good() );
+
+    EXPECT( freeze( value_ptr<Node>(), file.path ) );
+
+    mmap_view<Node> view( file.path );
+
+    EXPECT( view.good() );
+    EXPECT( view.get() == nullptr );
+    EXPECT( !view.thaw() );
+#else
+    EXPECT( !!"mmap_view: frozen trees are not available (no POSIX or no C++11)" );
+#endif
+}
+
+CASE( "mmap_view: Rejects a file of which the links do not form a tree (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace frozen;
+
+    // overwrite the link at member offset at of node i with an offset to node j:
+
+    struct patch
+    {
+        static bool link( char const * path, std::size_t i, std::size_t at, std::size_t j )
+        {
+            std::ptrdiff_t const offset = static_cast<std::ptrdiff_t>( sizeof( Node ) * j ) - static_cast<std::ptrdiff_t>( sizeof( Node ) * i + at );
+            off_t const pos = static_cast<off_t>( vptr::detail::frozen_nodes_offset<Node>() + sizeof( Node ) * i + at );
+
+            int const fd = ::open( path, O_WRONLY );
+            bool const ok = fd >= 0 && ::pwrite( fd, &offset, sizeof offset, pos ) == static_cast<ssize_t>( sizeof offset );
+            return ::close( fd ) == 0 && ok;
+        }
+    };
+
+    temp_path file;
+    Node probe( 0 );
+    std::size_t const left  = static_cast<std::size_t>( reinterpret_cast<char const *>( &probe.left  ) - reinterpret_cast<char const *>( &probe ) );
+    std::size_t const right = static_cast<std::size_t>( reinterpret_cast<char const *>( &probe.right ) - reinterpret_cast<char const *>( &probe ) );
+    int next = 0;
+
+    // nodes in depth-first order: 0 with children 1 and 2:
+
+    EXPECT( freeze( make_tree( 2, next ), file.path ) );
+    EXPECT( mmap_view<Node>( file.path ).good() );
+
+    EXPECT( patch::link( file.path, 1, left, 0 ) );         // back-edge to the root
+    EXPECT_NOT( mmap_view<Node>( file.path ).good() );
+
+    EXPECT( freeze( make_tree( 2, next ), file.path ) );
+    EXPECT( patch::link( file.path, 0, right, 1 ) );        // node 1 twice, node 2 not at all
+    EXPECT_NOT( mmap_view<Node>( file.path ).good() );
+
+    EXPECT( freeze( make_tree( 2, next ), file.path ) );
+    EXPECT( patch::link( file.path, 1, left, 1 ) );         // self-loop
+    EXPECT_NOT( mmap_view<Node>( file.path ).good() );
+#else
+    EXPECT( !!"mmap_view: frozen trees are not available (no POSIX or no C++11)" );
+#endif
+}
+
+CASE( "owned_bytes: Reports nodes, depth and fanout of a tree of value_ptr (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace serial;
+
+    value_ptr<Node> root = make_tree();
+    footprint const fp = owned_bytes( root );
+
+    EXPECT( fp.nodes      == 4u );
+    EXPECT( fp.max_depth  == 3u );
+    EXPECT( fp.node_bytes == 4 * sizeof( Node ) );
+    EXPECT( fp.allocated_bytes >= fp.node_bytes );
+    EXPECT( fp.payload_bytes   == 0u );
+    EXPECT( fp.total()  == fp.allocated_bytes );
+    EXPECT( fp.fanout.size() == 3u );
+    EXPECT( fp.fanout[0] == 2u );
+    EXPECT( fp.fanout[1] == 1u );
+    EXPECT( fp.fanout[2] == 1u );
+
+    footprint const none = owned_bytes( value_ptr<Node>() );
+
+    EXPECT( none.nodes     == 0u );
+    EXPECT( none.max_depth == 0u );
+    EXPECT( none.total()   == 0u );
+    EXPECT( none.fanout.empty() );
+#else
+    EXPECT( !!"owned_bytes: owned_bytes() is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace owned {
+
+struct Doc
+{
+    std::string text;
+    std::vector< value_ptr<Doc> > kids;
+
+    Doc( std::string t ) : text( t ), kids() {}
+};
+
+template< class F >
+void visit_children( Doc & doc, F & f )
+{
+    for ( auto & kid : doc.kids )
+        f( kid );
+}
+
+inline std::size_t owned_payload_bytes( Doc const & doc )
+{
+    using nonstd::owned_payload_bytes;
+    return owned_payload_bytes( doc.text ) + owned_payload_bytes( doc.kids );
+}
+
+// a base subobject that does not start its heap block:
+
+struct Other { virtual ~Other() {} long pad[4]; };
+struct Shape { virtual ~Shape() {} int sides; };
+struct Square : Other, Shape {};
+
+// a type that is allocated from its own pool, not via malloc():
+
+struct Pooled
+{
+    long value;
+
+    Pooled( long v ) : value( v ) {}
+
+    static void * operator new( std::size_t size )
+    {
+        alignas( std::max_align_t ) static unsigned char pool[ 1024 ];
+        static std::size_t used = 0;
+
+        void * const p = pool + used;
+        used += ( size + alignof( std::max_align_t ) - 1 ) / alignof( std::max_align_t ) * alignof( std::max_align_t );
+        return p;
+    }
+
+    static void operator delete( void * ) {}
+};
+}
+#endif
+
+CASE( "owned_bytes: Adds memory owned by the nodes via owned_payload_bytes() (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using owned::Doc;
+
+    value_ptr<Doc> root( Doc( std::string( 1000, 'x' ) ) );
+    root->kids.push_back( value_ptr<Doc>( Doc( "a" ) ) );
+
+    footprint const fp = owned_bytes( root );
+
+    EXPECT( owned_payload_bytes( std::string( "a" ) ) == 0u );
+    EXPECT( owned_payload_bytes( root->text ) == root->text.capacity() + 1 );
+    EXPECT( fp.nodes == 2u );
+    EXPECT( fp.payload_bytes == root->text.capacity() + 1 + root->kids.capacity() * sizeof( value_ptr<Doc> ) );
+    EXPECT( fp.total() == fp.allocated_bytes + fp.payload_bytes );
+#if nsvp_HAVE_MALLOC_USABLE_SIZE
+    EXPECT( fp.allocated_bytes == ::malloc_usable_size( root.get() ) + ::malloc_usable_size( root->kids[0].get() ) );
+#endif
+#else
+    EXPECT( !!"owned_bytes: owned_bytes() is not available (no C++11)" );
+#endif
+}
+
+CASE( "owned_bytes: Estimates the heap block of a polymorphic node, that may be a base subobject (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace owned;
+
+    value_ptr<Shape> shape( static_cast<Shape *>( new Square() ) );
+
+    std::size_t const align = 2 * sizeof( void * );
+    footprint const fp = owned_bytes( shape );
+
+    EXPECT( static_cast<void *>( shape.get() ) != static_cast<void *>( dynamic_cast<Square *>( shape.get() ) ) );
+    EXPECT( fp.nodes == 1u );
+    EXPECT( fp.allocated_bytes == ( sizeof( Shape ) + sizeof( std::size_t ) + align - 1 ) / align * align );
+#else
+    EXPECT( !!"owned_bytes: owned_bytes() is not available (no C++11)" );
+#endif
+}
+
+CASE( "owned_bytes: Estimates the heap block of a node with its own operator new (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using owned::Pooled;
+
+    value_ptr<Pooled> node( Pooled( 7 ) );
+
+    std::size_t const align = 2 * sizeof( void * );
+    footprint const fp = owned_bytes( node );
+
+    EXPECT( fp.nodes == 1u );
+    EXPECT( fp.allocated_bytes == ( sizeof( Pooled ) + sizeof( std::size_t ) + align - 1 ) / align * align );
+#else
+    EXPECT( !!"owned_bytes: owned_bytes() is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace tracing {
+
+struct TraceTracked
+{
+    int value[6];
+    TraceTracked( int v ) : value() { value[0] = v; }
+};
+
+struct counting_allocator
+{
+    std::size_t allocations;
+    std::size_t deallocations;
+    std::size_t live;
+
+    void * allocate( std::size_t size )
+    {
+        ++allocations; ++live;
+        return ::operator new( size );
+    }
+
+    void deallocate( void * p, std::size_t )
+    {
+        ++deallocations; --live;
+        ::operator delete( p );
+    }
+};
+}
+#endif
+
+CASE( "alloc_trace: Records clones and deletes of a traced_value_ptr (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using tracing::TraceTracked;
+
+    traced_value_ptr<TraceTracked> before( TraceTracked( 0 ) );
+    std::FILE * file = std::tmpfile();
+
+    EXPECT( alloc_trace::start( file ) );
+    EXPECT( alloc_trace::active() );
+    EXPECT_NOT( alloc_trace::start( file ) );
+
+    std::uint64_t first = 0, second = 0;
+    {
+        traced_value_ptr<TraceTracked> a( TraceTracked( 1 ) );
+        traced_value_ptr<TraceTracked> b( a );
+
+        first  = reinterpret_cast<std::uintptr_t>( a.get() );
+        second = reinterpret_cast<std::uintptr_t>( b.get() );
+    }
+    before.reset();
+
+    EXPECT( alloc_trace::stop() );
+    EXPECT_NOT( alloc_trace::active() );
+
+    traced_value_ptr<TraceTracked> after( TraceTracked( 2 ) );
+
+    std::rewind( file );
+    alloc_trace_data data;
+
+    EXPECT( load_alloc_trace( file, data ) );
+    std::fclose( file );
+
+    EXPECT( data.types.size() >= 1u );
+    EXPECT( data.records.size() == 5u );
+
+    std::uint16_t const type = data.records[0].type;
+
+    EXPECT( data.types[ type ].find( "TraceTracked" ) != std::string::npos );
+    EXPECT( ( data.records[0].op == alloc_trace_op::clone   ) );
+    EXPECT( ( data.records[1].op == alloc_trace_op::clone   ) );
+    EXPECT( ( data.records[2].op == alloc_trace_op::destroy ) );
+    EXPECT( ( data.records[3].op == alloc_trace_op::destroy ) );
+    EXPECT( ( data.records[4].op == alloc_trace_op::destroy ) );
+    EXPECT( data.records[0].address == first  );
+    EXPECT( data.records[1].address == second );
+    EXPECT( data.records[2].address == second );
+    EXPECT( data.records[3].address == first  );
+    EXPECT( data.records[4].size == sizeof( TraceTracked ) );
+    EXPECT( data.records[4].time >= data.records[0].time );
+#else
+    EXPECT( !!"alloc_trace: alloc_trace is not available (no C++11)" );
+#endif
+}
+
+CASE( "alloc_trace: Replays a trace against a user-provided allocator (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using tracing::TraceTracked;
+
+    std::FILE * file = std::tmpfile();
+    traced_value_ptr<TraceTracked> before( TraceTracked( 0 ) );
+
+    EXPECT( alloc_trace::start( file ) );
+    {
+        std::vector< traced_value_ptr<TraceTracked> > v;
+
+        for ( int i = 0; i < 10; ++i )
+            v.push_back( traced_value_ptr<TraceTracked>( TraceTracked( i ) ) );
+    }
+    traced_value_ptr<TraceTracked> live( TraceTracked( 10 ) );
+    before.reset();
+    EXPECT( alloc_trace::stop() );
+
+    std::rewind( file );
+    alloc_trace_data data;
+
+    EXPECT( load_alloc_trace( file, data ) );
+    std::fclose( file );
+
+    tracing::counting_allocator alloc = { 0, 0, 0 };
+    replay_result const result = replay( data, alloc );
+
+    EXPECT( result.clones     == 11u );
+    EXPECT( result.deletes    == 10u );
+    EXPECT( result.unmatched  ==  1u );
+    EXPECT( result.peak_bytes == 10 * sizeof( TraceTracked ) );
+    EXPECT( alloc.allocations   == 11u );
+    EXPECT( alloc.deallocations == 11u );
+    EXPECT( alloc.live == 0u );
+
+    std::FILE * foreign = std::tmpfile();
+    std::fputs( "not a trace", foreign );
+    std::rewind( foreign );
+
+    EXPECT_NOT( load_alloc_trace( foreign, data ) );
+    EXPECT( data.records.empty() );
+    std::fclose( foreign );
+#else
+    EXPECT( !!"alloc_trace: alloc_trace is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_HAVE_MEMFD
+#include <sys/wait.h>
+
+namespace memfd {
+
+struct Big
+{
+    unsigned char data[ 4 * 1024 * 1024 ];
+};
+}
+#endif
+
+CASE( "memfd_clone: Allows copy-on-write clones of a large trivially copyable object (Linux)" )
+{
+#if nsvp_HAVE_MEMFD
+    using memfd::Big;
+
+    std::size_t const page = std::size_t( ::sysconf( _SC_PAGESIZE ) );
+    std::unique_ptr<Big> init( new Big() );
+
+    for ( std::size_t i = 0; i < sizeof init->data; i += page )
+        init->data[i] = static_cast<unsigned char>( i / page );
+
+    memfd_value_ptr<Big> a( *init );
+
+    EXPECT( reinterpret_cast<std::uintptr_t>( a.get() ) % page == 0u );
+
+    a->data[ 3 * page ] = 200;
+
+    memfd_value_ptr<Big> b( a );
+
+    b->data[ 5 * page ] = 201;
+
+    memfd_value_ptr<Big> c( b );
+
+    EXPECT( b->data[ 3 * page ] == 200 );
+    EXPECT( a->data[ 5 * page ] == 5   );
+    EXPECT( c->data[ 5 * page ] == 201 );
+    EXPECT( c->data[ 7 * page ] == 7   );
+    EXPECT( std::memcmp( a->data + 6 * page, init->data + 6 * page, sizeof init->data - 6 * page ) == 0 );
+#else
+    EXPECT( !!"memfd_clone: memfd_clone is not available (no Linux memfd_create())" );
+#endif
+}
+
+CASE( "memfd_clone: Shares one file descriptor among the copies of an object (Linux)" )
+{
+#if nsvp_HAVE_MEMFD
+    using memfd::Big;
+
+    struct lowest_free_fd
+    {
+        static int get()
+        {
+            int const fd = ::open( "/dev/null", O_RDONLY | O_CLOEXEC );
+            ::close( fd );
+            return fd;
+        }
+    };
+
+    std::unique_ptr<Big> init( new Big() );
+    init->data[0] = 1;
+
+    std::vector< memfd_value_ptr<Big> > copies;
+    copies.emplace_back( *init );
+    copies.push_back( copies.back() );
+
+    int const before = lowest_free_fd::get();
+
+    for ( int i = 0; i < 100; ++i )
+        copies.push_back( copies.back() );
+
+    copies[50]->data[0] = 2;
+    copies[0] = copies[50];
+
+    EXPECT( lowest_free_fd::get() == before );
+    EXPECT( copies[0]->data[0] == 2 );
+    EXPECT( copies[1]->data[0] == 1 );
+
+    copies.clear();
+
+    EXPECT( lowest_free_fd::get() < before );
+#else
+    EXPECT( !!"memfd_clone: memfd_clone is not available (no Linux memfd_create())" );
+#endif
+}
+
+CASE( "memfd_clone: Copies the pages written by a child process after fork() (Linux)" )
+{
+#if nsvp_HAVE_MEMFD
+    using memfd::Big;
+
+    std::size_t const page = std::size_t( ::sysconf( _SC_PAGESIZE ) );
+    std::unique_ptr<Big> init( new Big() );
+
+    memfd_value_ptr<Big> a( *init );
+    memfd_value_ptr<Big> b( a );
+
+    ::pid_t const pid = ::fork();
+
+    if ( pid == 0 )
+    {
+        a->data[ 3 * page ] = 200;
+
+        memfd_value_ptr<Big> c( a );
+
+        ::_exit( c->data[ 3 * page ] == 200 ? 0 : 1 );
+    }
+
+    int status = -1;
+
+    EXPECT( pid > 0 );
+    EXPECT( ::waitpid( pid, &status, 0 ) == pid );
+    EXPECT( WIFEXITED( status ) );
+    EXPECT( WEXITSTATUS( status ) == 0 );
+    EXPECT( b->data[ 3 * page ] == 0 );
+#else
+    EXPECT( !!"memfd_clone: memfd_clone is not available (no Linux memfd_create())" );
+#endif
+}
+
+CASE( "memfd_clone: Allocates an object smaller than a page on the heap (Linux)" )
+{
+#if nsvp_HAVE_MEMFD
+    memfd_value_ptr<int> a( 7 );
+    memfd_value_ptr<int> b( a );
+
+    *b = 8;
+
+    EXPECT( *a == 7 );
+    EXPECT( *b == 8 );
+#else
+    EXPECT( !!"memfd_clone: memfd_clone is not available (no Linux memfd_create())" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace locality {
+
+struct HintSpy
+{
+    static void const * & last() { static void const * hint = nullptr; return hint; }
+
+    int * operator()( int const & x, void const * hint ) const
+    {
+        last() = hint; return new int( x );
+    }
+};
+
+struct Node
+{
+    int value;
+    locality_value_ptr<Node> left;
+    locality_value_ptr<Node> right;
+
+    Node( int v ) : value( v ), left(), right() {}
+};
+
+struct Big
+{
+    char data[ 8000 ];
+};
+
+inline locality_value_ptr<Node> make_tree( int height, int & next )
+{
+    if ( height == 0 )
+        return locality_value_ptr<Node>();
+
+    locality_value_ptr<Node> node( Node( next++ ) );
+    node->left  = make_tree( height - 1, next );
+    node->right = make_tree( height - 1, next );
+    return node;
+}
+
+// sum of the values and the address range spanned by the nodes:
+
+inline int span( locality_value_ptr<Node> const & node, char const *& lo, char const *& hi )
+{
+    if ( ! node )
+        return 0;
+
+    char const * p = reinterpret_cast<char const *>( node.get() );
+    lo = std::min( lo, p );
+    hi = std::max( hi, p );
+
+    return node->value + span( node->left, lo, hi ) + span( node->right, lo, hi );
+}
+}
+#endif
+
+CASE( "value_ptr: Passes its address as placement hint to a cloner that accepts one (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace locality;
+
+    value_ptr<int, HintSpy> a( 7 );
+
+    EXPECT( HintSpy::last() == static_cast<void const *>( &a ) );
+
+    value_ptr<int, HintSpy> b( a );
+
+    EXPECT( HintSpy::last() == static_cast<void const *>( &b ) );
+#else
+    EXPECT( !!"value_ptr: placement hint is not available (no C++11)" );
+#endif
+}
+
+CASE( "locality_clone: Allows to place a clone in the region of its hint, rather than in the newest region (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace locality;
+    using vptr::detail::locality_arena;
+    using vptr::detail::locality_region;
+
+    std::size_t const region_size = locality_arena::region_size;
+    std::size_t const big_slot    = locality_arena::header_size + locality_region::round_up( sizeof( Big ) );
+
+    locality_clone <int> clone;
+    locality_clone <Big> clone_big;
+    std::vector<Big *>   fillers;
+
+    auto distance = []( void const * a, void const * b )
+    {
+        return static_cast<std::size_t>( std::abs( static_cast<char const *>( a ) - static_cast<char const *>( b ) ) );
+    };
+
+    // allocate until an object starts a new region, leaving the previous one
+    // with too little room for another Big:
+
+    auto fill = [&]()
+    {
+        fillers.push_back( clone_big( Big() ) );
+        do
+        {
+            fillers.push_back( clone_big( Big() ) );
+        }
+        while ( distance( fillers[ fillers.size() - 2 ], fillers.back() ) == big_slot );
+    };
+
+    fill();
+    int * parent = clone( 1 );
+    fill();
+    int * child  = clone( 2, parent );
+
+    // next to the last Big that fitted in the region of the parent:
+
+    EXPECT( distance( child, parent ) < region_size );
+    EXPECT( distance( child, fillers[ fillers.size() - 2 ] ) == big_slot );
+
+    locality_delete<int>()( child  );
+    locality_delete<int>()( parent );
+    for ( Big * p : fillers ) locality_delete<Big>()( p );
+#else
+    EXPECT( !!"locality_clone: locality-aware cloning is not available (no C++11)" );
+#endif
+}
+
+CASE( "locality_clone: Allows to deep copy a tree with its nodes clustered (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace locality;
+
+    int next = 0;
+    locality_value_ptr<Node> tree = make_tree( 6, next );
+    locality_value_ptr<Node> copy( tree );
+
+    tree.reset();
+
+    std::size_t const region_size = vptr::detail::locality_arena::region_size;
+
+    char const * lo = reinterpret_cast<char const *>( copy.get() );
+    char const * hi = lo;
+
+    EXPECT( span( copy, lo, hi ) == 63 * 62 / 2 );
+    EXPECT( static_cast<std::size_t>( hi - lo ) < region_size );
+#else
+    EXPECT( !!"locality_clone: locality-aware cloning is not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to prefetch its content" )
+{
+    value_ptr<int> d;
+    value_ptr<int> e( 7 );
+
+    d.prefetch();
+    e.prefetch();
+
+    EXPECT( *e == 7 );
+}
+
+CASE( "prefetch_deref_view: Allows to iterate over the content of a range of value_ptr while prefetching ahead (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    std::vector< value_ptr<int> > vec;
+
+    for ( int i = 1; i <= 10; ++i )
+        vec.push_back( value_ptr<int>( i ) );
+
+    SETUP( "" ) {
+    SECTION( "any distance visits each element once" )
+    {
+        std::size_t const distances[] = { 0, 1, 3, 10, 100 };
+
+        for ( std::size_t distance : distances )
+        {
+            int sum = 0;
+            for ( int & x : prefetch_deref_view( vec, distance ) )
+                sum += x;
+
+            EXPECT( sum == 55 );
+        }
+    }
+
+    SECTION( "yields references to the content" )
+    {
+        for ( int & x : prefetch_deref_view( vec ) )
+            x *= 2;
+
+        EXPECT( *vec.front() ==  2 );
+        EXPECT( *vec.back()  == 20 );
+    }}
+#else
+    EXPECT( !!"prefetch_deref_view: prefetching view is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace gather_scatter {
+
+struct Record
+{
+    int    id;
+    double price;
+
+    Record( int i, double p ) : id( i ), price( p ) {}
+};
+
+inline std::vector< value_ptr<Record> > make_records()
+{
+    std::vector< value_ptr<Record> > records;
+
+    for ( int i = 0; i != 10; ++i )
+        records.push_back( i % 3 == 1 ? value_ptr<Record>() : value_ptr<Record>( Record( i, 1.5 * i ) ) );
+
+    return records;
+}
+}
+#endif
+
+CASE( "gather: Allows to copy a member of the content of a range of value_ptr into a dense array (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace gather_scatter;
+
+    std::vector< value_ptr<Record> > const records = make_records();
+
+    SETUP( "" ) {
+    SECTION( "skip empty elements, project via member pointer" )
+    {
+        std::vector<double> prices;
+
+        gather( records, &Record::price, std::back_inserter( prices ) );
+
+        EXPECT( prices.size() == 7u );
+        EXPECT( prices[0] == 0.0 );
+        EXPECT( prices[1] == 3.0 );
+        EXPECT( prices[6] == 13.5 );
+    }
+
+    SECTION( "skip empty elements, non-random-access range" )
+    {
+        std::list< value_ptr<Record> > list( records.begin(), records.end() );
+        std::vector<int> ids;
+
+        gather( list, &Record::id, std::back_inserter( ids ) );
+
+        EXPECT( ids.size() == 7u );
+        EXPECT( ids.back() == 9 );
+    }
+
+    SECTION( "value-initialize for empty elements, project via callable" )
+    {
+        int ids[10] = { 0 };
+        int * end = gather( records, []( Record const & r ) { return r.id * 10; }, ids, null_policy::value_init );
+
+        EXPECT( end == ids + 10 );
+        EXPECT( ids[1] ==  0 );
+        EXPECT( ids[2] == 20 );
+        EXPECT( ids[9] == 90 );
+    }
+
+    SECTION( "value-initialize and mask empty elements" )
+    {
+        double prices[10];
+        bool   mask  [10];
+
+        auto const ends = gather( records, &Record::price, prices, null_policy::mask, mask );
+
+        EXPECT( ends.first  == prices + 10 );
+        EXPECT( ends.second == mask + 10 );
+        EXPECT(     mask[0] );
+        EXPECT_NOT( mask[1] );
+        EXPECT_NOT( mask[7] );
+        EXPECT(     mask[9] );
+        EXPECT( prices[7] ==  0.0 );
+        EXPECT( prices[9] == 13.5 );
+    }}
+#else
+    EXPECT( !!"gather: gather is not available (no C++11)" );
+#endif
+}
+
+CASE( "scatter: Allows to assign a member of the content of a range of value_ptr from a dense array (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using namespace gather_scatter;
+
+    std::vector< value_ptr<Record> > records = make_records();
+
+    SETUP( "" ) {
+    SECTION( "input for engaged elements only" )
+    {
+        std::vector<double> prices( 7, 2.0 );
+
+        EXPECT( ( scatter( records, &Record::price, prices.begin() ) == prices.end() ) );
+        EXPECT( records[0]->price == 2.0 );
+        EXPECT( records[9]->price == 2.0 );
+    }
+
+    SECTION( "input for each element, ignored for empty elements" )
+    {
+        double prices[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+        scatter( records, []( Record & r ) -> double & { return r.price; }, prices, null_policy::value_init );
+
+        EXPECT( records[2]->price == 2.0 );
+        EXPECT( records[9]->price == 9.0 );
+    }}
+#else
+    EXPECT( !!"scatter: scatter is not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to obtain pointer to value via operator->()" )
+{
+    SETUP( "" )
+    {
+        value_ptr<Integer> e( Integer( 42 ) );
+
+    SECTION( "operator->() yields pointer to value (const)" )
+    {
+        EXPECT(  e->x == 42 );
+    }
+
+    SECTION( "operator->() yields pointer to value (non-const)" )
+    {
+        e->x = 7;
+        EXPECT(  e->x == 7 );
+    }}
+}
+
+CASE( "value_ptr: Allows to obtain value via operator*()" )
+{
+    SETUP( "" )
+    {
+        value_ptr<int> e( 42 );
+
+    SECTION( "operator*() yields value (const)" )
+    {
+        EXPECT( *e == 42 );
+    }
+
+    SECTION( "operator*() yields value (non-const)" )
+    {
+        *e = 7;
+        EXPECT( *e == 7 );
+    }}
+}
+
+CASE( "value_ptr: Allows to obtain moved-value via operator*()" )
+{
+}
+
+CASE( "value_ptr: Allows to obtain engaged state via operator bool()" )
+{
+    value_ptr<int> a;
+    value_ptr<int> b( 7 );
+
+    EXPECT_NOT( a );
+    EXPECT(     b );
+}
+
+CASE( "value_ptr: Allows to obtain engaged state via has_value()" )
+{
+    value_ptr<int> a;
+    value_ptr<int> b( 7 );
+
+    EXPECT_NOT( a.has_value() );
+    EXPECT(     b.has_value() );
+}
+
+CASE( "value_ptr: Allows to obtain value via value()" )
+{
+    SETUP( "" )
+    {
+        value_ptr<int> e( 42 );
+
+    SECTION( "value() yields value (const)" )
+    {
+        EXPECT( e.value() == 42 );
+    }
+
+    SECTION( "value() yields value (non-const)" )
+    {
+        e.value() = 7;
+
+        EXPECT( e.value() == 7 );
+    }}
+}
+
+CASE( "value_ptr: Allows to obtain value or default via value_or()" )
+{
+    SETUP( "" )
+    {
+        value_ptr<int> d;
+        value_ptr<int> e( 42 );
+
+    SECTION( "value_or( 7 ) yields value for non-empty value_ptr" )
+    {
+        EXPECT( e.value_or( 7 ) == 42 );
+    }
+
+    SECTION( "value_or( 7 ) yields default for empty value_ptr" )
+    {
+        EXPECT( d.value_or( 7 ) == 7 );
+    }}
+}
+
+CASE( "value_ptr: Allows to obtain moved-default via value_or() (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    S s( 7 );
+    value_ptr<S> d;
+
+    EXPECT( s.state == value_move_constructed );
+    EXPECT( d.value_or( std::move(s) ).value == S(7).value );
+    EXPECT( s.state == moved_from );
+#else
+    EXPECT( !!"value_ptr: move-semantics are not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to move out the value via value() and operator* of an rvalue (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_REF_QUALIFIER
+    SETUP( "" )
+    {
+        value_ptr<S> e( S( 7 ) );
+
+    SECTION( "value() &&" )
+    {
+        S s( std::move( e ).value() );
+
+        EXPECT( s.state  == move_constructed );
+        EXPECT( e->state == moved_from       );
+        EXPECT( e.has_value() );
+    }
+
+    SECTION( "operator* &&" )
+    {
+        S s( *std::move( e ) );
+
+        EXPECT( s.state  == move_constructed );
+        EXPECT( e->state == moved_from       );
+    }}
+#else
+    EXPECT( !!"value_ptr: ref-qualified observers are not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to move out the value via value_or() of an rvalue (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_REF_QUALIFIER
+    value_ptr<S> e( S( 7 ) );
+
+    S s( std::move( e ).value_or( S( 5 ) ) );
+
+    EXPECT( s.value  == S( 7 ).value );
+    EXPECT( e->state == moved_from   );
+#else
+    EXPECT( !!"value_ptr: ref-qualified observers are not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to move out the value and disengage via take()" )
+{
+    value_ptr<S> e( S( 7 ) );
+
+    S s( e.take() );
+
+    EXPECT( s.value == S( 7 ).value );
+    EXPECT_NOT( e.has_value() );
+#if nsvp_CPP11_OR_GREATER
+    EXPECT( s.state == move_constructed );
+#endif
+    EXPECT_THROWS_AS( e.take(), bad_value_access );
+}
+
+CASE( "value_ptr: Throws bad_value_access at disengaged access" )
+{
+    value_ptr<int>       vp;
+    value_ptr<int> const cvp;
+
+    EXPECT_THROWS_AS(  vp.value(), bad_value_access );
+    EXPECT_THROWS_AS( cvp.value(), bad_value_access );
+}
+
+// modifiers:
+
+CASE( "value_ptr: Allows to release its content" )
+{
+    value_ptr<int> a = 7;
+
+    int * ap = a.release();
+
+    EXPECT_NOT(  a       );
+    EXPECT(     *ap == 7 ); delete ap;
+}
+
+CASE( "value_ptr: Allows to release its content into a unique_ptr or shared_ptr without cloning (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    SETUP( "" )
+    {
+        value_ptr<int> vp( 7 );
+        int * const p = vp.get();
+
+    SECTION( "to_unique()" )
+    {
+        std::unique_ptr<int> up = std::move( vp ).to_unique();
+
+        EXPECT( up.get() == p );
+        EXPECT_NOT( vp );
+    }
+
+    SECTION( "to_shared()" )
+    {
+        std::shared_ptr<int const> sp = std::move( vp ).to_shared();
+
+        EXPECT( sp.get() == p );
+        EXPECT_NOT( vp );
+        EXPECT( std::move( vp ).to_shared().get() == nullptr );
+    }}
+#else
+    EXPECT( !!"value_ptr: conversion to unique_ptr and shared_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr: Allows to clear its content (reset)" )
+{
+    value_ptr<int> a = 7;
+
+    a.reset();
+
+    EXPECT_NOT( a );
+}
+
+CASE( "value_ptr: Allows to replace its content (reset)" )
+{
+    value_ptr<int> a;
+    int * ap = new int( 7 );
+
+    a.reset( ap );
+
+    EXPECT(  a      );
+    EXPECT( *a == 7 );
+}
+
+// swap:
+
+CASE( "value_ptr: Allows to swap with other value_ptr (member)" )
+{
+    SETUP( "" )
+    {
+        value_ptr<int> d1;
+        value_ptr<int> d2;
+        value_ptr<int> e1( 42 );
+        value_ptr<int> e2( 7 );
+
+    SECTION( "swap disengaged with disengaged value_ptr" )
+    {
+        d1.swap( d2 );
+
+        EXPECT( !d1 );
+        EXPECT(  d1.get() == d2.get() );
+    }
+
+    SECTION( "swap engaged with engaged value_ptr" )
+    {
+        e1.swap( e2 );
+
+        EXPECT(  e1  );
+        EXPECT(  e2 );
+        EXPECT( *e1 == 7 );
+        EXPECT( *e2 == 42 );
+        EXPECT(  e1.get() != e2.get() );
+    }
+
+    SECTION( "swap disengaged with engaged value_ptr" )
+    {
+        d1.swap( e1 );
+
+        EXPECT(  d1 );
+        EXPECT( !e1 );
+        EXPECT( *d1 == 42 );
+        EXPECT(  d1.get() != e1.get() );
+    }
+
+    SECTION( "swap engaged with disengaged value_ptr" )
+    {
+        e1.swap( d1 );
+
+        EXPECT(  d1 );
+        EXPECT( !e1 );
+        EXPECT( *d1 == 42 );
+        EXPECT(  d1.get() != e1.get() );
+    }}
+}
+
+//
+// value_ptr non-member functions:
+//
+
+CASE( "value_ptr: Allows to swap with other value_ptr (non-member)" )
+{
+    SETUP( "" )
+    {
+        value_ptr<int> d1;
+        value_ptr<int> d2;
+        value_ptr<int> e1( 42 );
+        value_ptr<int> e2( 7 );
+
+    SECTION( "swap disengaged with disengaged value_ptr" )
+    {
+        swap( d1, d2 );
+
+        EXPECT( !d1 );
+        EXPECT(  d1.get() == d2.get() );
+    }
+    SECTION( "swap engaged with engaged value_ptr" )
+    {
+        swap( e1, e2 );
+
+        EXPECT(  e1  );
+        EXPECT(  e2 );
+        EXPECT( *e1 == 7 );
+        EXPECT( *e2 == 42 );
+        EXPECT(  e2.get() != e1.get() );
+    }
     SECTION( "swap disengaged with engaged value_ptr" )
     {
-        swap( d1, e1 );
+        swap( d1, e1 );
+
+        EXPECT(  d1 );
+        EXPECT( !e1 );
+        EXPECT( *d1 == 42 );
+        EXPECT(  d1.get() != e1.get() );
+    }
+    SECTION( "swap engaged with disengaged value_ptr" )
+    {
+        swap( e1, d1 );
+
+        EXPECT(  d1 );
+        EXPECT( !e1 );
+        EXPECT( *d1 == 42 );
+        EXPECT(  d1.get() != e1.get() );
+    }}
+}
+
+namespace compare_pointers {
+
+    struct C
+    {
+        int * operator()( int const & x ) const
+        {
+            static int a[3];
+            return & ( a[x] = -x );
+        }
+    };
+    struct D
+    {
+        void operator()( int * ptr ) const {}
+    };
+}
+
+CASE( "value_ptr: Provides relational operators (non-member, pointer comparison: nsvp_CONFIG_COMPARE_POINTERS!=0)" )
+{
+#if nsvp_CONFIG_COMPARE_POINTERS
+    using namespace compare_pointers;
+
+    SETUP( "" ) {
+
+    value_ptr<int, C, D> e1( 1 );
+    value_ptr<int, C, D> e2( 2 );
+
+    SECTION( "engaged == engaged" ) { EXPECT(     e1 == e1  ); }
+    SECTION( "engaged != engaged" ) { EXPECT(     e1 != e2  ); }
+
+    SECTION( "engaged <  engaged" ) { EXPECT(     e1 <  e2  ); }
+    SECTION( "engaged <= engaged" ) { EXPECT(     e1 <= e1  ); }
+    SECTION( "engaged <= engaged" ) { EXPECT(     e1 <= e2  ); }
+
+    SECTION( "engaged >  engaged" ) { EXPECT(     e2 >  e1  ); }
+    SECTION( "engaged >= engaged" ) { EXPECT(     e1 >= e1  ); }
+    SECTION( "engaged >= engaged" ) { EXPECT(     e2 >= e1  ); }
+
+#if nsvp_HAVE_NULLPTR
+    auto np = nullptr;
+
+    SECTION( "engaged == nullptr" ) { EXPECT_NOT( e1 == np ); }
+    SECTION( "engaged != nullptr" ) { EXPECT(     e1 != np ); }
+
+    SECTION( "engaged <  nullptr" ) { EXPECT_NOT( e1 <  np ); }
+    SECTION( "engaged <= nullptr" ) { EXPECT_NOT( e1 <= np ); }
+
+    SECTION( "engaged >  nullptr" ) { EXPECT(     e1 >  np ); }
+    SECTION( "engaged >= nullptr" ) { EXPECT(     e1 >= np ); }
+
+    SECTION( "nullptr == engaged" ) { EXPECT_NOT( np == e1 ); }
+    SECTION( "nullptr != engaged" ) { EXPECT(     np != e1 ); }
+
+    SECTION( "nullptr <  engaged" ) { EXPECT(     np <  e1 ); }
+    SECTION( "nullptr <= engaged" ) { EXPECT(     np <= e1 ); }
+
+    SECTION( "nullptr >  engaged" ) { EXPECT_NOT( np >  e1 ); }
+    SECTION( "nullptr >= engaged" ) { EXPECT_NOT( np >= e1 ); }
+#endif
+    }
+#else
+    EXPECT( !!"value_ptr: pointer comparison is not available (nsvp_CONFIG_COMPARE_POINTERS undefined or 0)" );
+#endif
+}
+
+CASE( "value_ptr: Provides relational operators (non-member, value comparison: nsvp_CONFIG_COMPARE_POINTERS==0)" )
+{
+#if ! nsvp_CONFIG_COMPARE_POINTERS
+    using namespace compare_pointers;
+
+    SETUP( "" ) {
+
+    value_ptr<int> de;
+    value_ptr<int> e1( 1 );
+    value_ptr<int> e2( 2 );
+
+    SECTION( "engaged    == engaged"    ) { EXPECT(     e1 == e1  ); }
+    SECTION( "engaged    != engaged"    ) { EXPECT(     e1 != e2  ); }
+
+    SECTION( "engaged    <  engaged"    ) { EXPECT(     e1 <  e2  ); }
+    SECTION( "engaged    <= engaged"    ) { EXPECT(     e1 <= e1  ); }
+    SECTION( "engaged    <= engaged"    ) { EXPECT(     e1 <= e2  ); }
+
+    SECTION( "engaged    >  engaged"    ) { EXPECT(     e2 >  e1  ); }
+    SECTION( "engaged    >= engaged"    ) { EXPECT(     e1 >= e1  ); }
+    SECTION( "engaged    >= engaged"    ) { EXPECT(     e2 >= e1  ); }
+
+    SECTION( "disengaged == disengaged" ) { EXPECT(     de == de  ); }
+    SECTION( "disengaged != disengaged" ) { EXPECT_NOT( de != de  ); }
+    SECTION( "disengaged <  disengaged" ) { EXPECT_NOT( de <  de  ); }
+    SECTION( "disengaged <= disengaged" ) { EXPECT(     de <= de  ); }
+    SECTION( "disengaged >  disengaged" ) { EXPECT_NOT( de >  de  ); }
+    SECTION( "disengaged >= disengaged" ) { EXPECT(     de >= de  ); }
+
+    SECTION( "engaged    == disengaged" ) { EXPECT_NOT( e1 == de  ); }
+    SECTION( "engaged    != disengaged" ) { EXPECT(     e1 != de  ); }
+    SECTION( "engaged    <  disengaged" ) { EXPECT_NOT( e1 <  de  ); }
+    SECTION( "engaged    <= disengaged" ) { EXPECT_NOT( e1 <= de  ); }
+    SECTION( "engaged    >  disengaged" ) { EXPECT(     e1 >  de  ); }
+    SECTION( "engaged    >= disengaged" ) { EXPECT(     e1 >= de  ); }
+
+    SECTION( "disengaged == engaged"    ) { EXPECT_NOT( de == e1  ); }
+    SECTION( "disengaged != engaged"    ) { EXPECT(     de != e1  ); }
+    SECTION( "disengaged <  engaged"    ) { EXPECT(     de <  e1  ); }
+    SECTION( "disengaged <= engaged"    ) { EXPECT(     de <= e1  ); }
+    SECTION( "disengaged >  engaged"    ) { EXPECT_NOT( de >  e1  ); }
+    SECTION( "disengaged >= engaged"    ) { EXPECT_NOT( de >= e1  ); }
+#if nsvp_HAVE_NULLPTR
+    SECTION( "engaged    == nullptr"    ) { EXPECT_NOT( e1 == nullptr ); EXPECT_NOT( nullptr == e1 ); }
+    SECTION( "engaged    != nullptr"    ) { EXPECT(     e1 != nullptr ); EXPECT(     nullptr != e1 ); }
+    SECTION( "disengaged == nullptr"    ) { EXPECT(     de == nullptr ); EXPECT(     nullptr == de ); }
+    SECTION( "disengaged != nullptr"    ) { EXPECT_NOT( de != nullptr ); EXPECT_NOT( nullptr != de ); }
+#endif
+    }
+#else
+    EXPECT( !!"value_ptr: value comparison is not available (nsvp_CONFIG_COMPARE_POINTERS is non-zero)" );
+#endif
+}
+
+CASE( "value_ptr: Provides relational operators (non-member, mixed value comparison: nsvp_CONFIG_COMPARE_POINTERS==0)" )
+{
+#if ! nsvp_CONFIG_COMPARE_POINTERS
+    using namespace compare_pointers;
+
+    SETUP( "" ) {
+
+    value_ptr<int> e1( 1 );
+    value_ptr<int> e2( 2 );
+    int            v1( 1 );
+    int            v2( 2 );
+
+    SECTION( "engaged == value"   ) { EXPECT(   e1 == v1  ); }
+    SECTION( "engaged != value"   ) { EXPECT(   e1 != v2  ); }
+    SECTION( "engaged <  value"   ) { EXPECT(   e1 <  v2  ); }
+    SECTION( "engaged <= value"   ) { EXPECT(   e1 <= v1  ); }
+    SECTION( "engaged <= value"   ) { EXPECT(   e1 <= v2  ); }
+    SECTION( "engaged >  value"   ) { EXPECT(   e2 >  v1  ); }
+    SECTION( "engaged >= value"   ) { EXPECT(   e1 >= v1  ); }
+    SECTION( "engaged >= value"   ) { EXPECT(   e2 >= v1  ); }
+
+    SECTION( "value   == engaged" ) { EXPECT(   v1 == e1  ); }
+    SECTION( "value   != engaged" ) { EXPECT(   v2 != e1  ); }
+    SECTION( "value   <  engaged" ) { EXPECT(   v1 <  e2  ); }
+    SECTION( "value   <= engaged" ) { EXPECT(   v1 <= e1  ); }
+    SECTION( "value   <= engaged" ) { EXPECT(   v1 <= e2  ); }
+    SECTION( "value   >  engaged" ) { EXPECT(   v2 >  e1  ); }
+    SECTION( "value   >= engaged" ) { EXPECT(   v1 >= e1  ); }
+    SECTION( "value   >= engaged" ) { EXPECT(   v2 >= e1  ); }
+    }
+#else
+    EXPECT( !!"value_ptr: value comparison is not available (nsvp_CONFIG_COMPARE_POINTERS is non-zero)" );
+#endif
+}
+
+namespace three_way {
+
+    // orders via operator< only, to exercise the synthesized three-way comparison:
+
+    struct LessOnly
+    {
+        int v;
+        LessOnly( int v_ ) : v( v_ ) {}
+        friend bool operator<( LessOnly const & a, LessOnly const & b ) { return a.v < b.v; }
+    };
+}
+
+CASE( "value_ptr: Provides three-way comparison (non-member, C++20)" )
+{
+#if nsvp_HAVE_THREE_WAY_COMPARISON
+    SETUP( "" ) {
+#if nsvp_CONFIG_COMPARE_POINTERS
+    value_ptr<int> e1( 1 );
+    value_ptr<int> e2( 2 );
+
+    SECTION( "engaged <=> engaged" ) { EXPECT( std::is_eq( e1 <=> e1 ) );
+                                       EXPECT( std::is_lt( e1 <=> e2 ) == std::less<int const *>()( e1.get(), e2.get() ) ); }
+    SECTION( "engaged <=> nullptr" ) { EXPECT( std::is_gt( e1 <=> nullptr ) );
+                                       EXPECT( std::is_lt( nullptr <=> e1 ) ); }
+#else
+    value_ptr<int> de;
+    value_ptr<int> e1( 1 );
+    value_ptr<int> e2( 2 );
+
+    SECTION( "engaged    <=> engaged"    ) { EXPECT( std::is_lt( e1 <=> e2 ) ); EXPECT( std::is_gt( e2 <=> e1 ) ); EXPECT( std::is_eq( e1 <=> e1 ) ); }
+    SECTION( "disengaged <=> disengaged" ) { EXPECT( std::is_eq( de <=> de ) ); }
+    SECTION( "engaged    <=> disengaged" ) { EXPECT( std::is_gt( e1 <=> de ) ); EXPECT( std::is_lt( de <=> e1 ) ); }
+    SECTION( "engaged    <=> value"      ) { EXPECT( std::is_lt( e1 <=> 2 ) ); EXPECT( std::is_gt( 2 <=> e1 ) ); EXPECT( std::is_eq( e2 <=> 2 ) ); }
+    SECTION( "disengaged <=> value"      ) { EXPECT( std::is_lt( de <=> 0 ) ); EXPECT( std::is_gt( 0 <=> de ) ); }
+    SECTION( "engaged    <=> nullptr"    ) { EXPECT( std::is_gt( e1 <=> nullptr ) ); EXPECT( std::is_lt( nullptr <=> e1 ) ); EXPECT( e1 != nullptr ); }
+    SECTION( "disengaged <=> nullptr"    ) { EXPECT( std::is_eq( de <=> nullptr ) ); EXPECT( de == nullptr ); EXPECT( nullptr == de ); }
+    SECTION( "synthesized from operator<" ) {
+        using namespace three_way;
+        value_ptr<LessOnly> a( 1 ), b( 2 );
+        EXPECT( ( std::is_same<decltype( a <=> b ), std::weak_ordering>::value ) );
+        EXPECT( std::is_lt( a <=> b ) );
+        EXPECT( std::is_gt( b <=> a ) );
+        EXPECT( std::is_eq( a <=> a ) ); }
+#endif
+    }
+#else
+    EXPECT( !!"value_ptr: three-way comparison is not available (no C++20)" );
+#endif
+}
+
+CASE( "make_value: Allows to copy-construct value_ptr" )
+{
+    S s( 7 );
+
+    EXPECT( make_value( s )->value == 7          );
+    EXPECT(                s.state != moved_from );
+}
+
+CASE( "make_value: Allows to move-construct value_ptr (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    S s( 7 );
+
+    EXPECT( make_value( std::move( s ) )->value == 7          );
+    EXPECT(                             s.state == moved_from );
+#else
+    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+#endif
+}
+
+CASE( "make_value: Allows to in-place copy-construct value_ptr from arguments (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using pair_t = std::pair<char, S>;
+
+    S s( 7);
+    auto a = make_value<pair_t>( 'a', s );
+
+    EXPECT( a->first        == 'a' );
+    EXPECT( a->second.value ==  7  );
+    EXPECT( a->second.state == copy_constructed );
+    EXPECT(         s.state != moved_from       );
+#else
+    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+#endif
+}
+
+CASE( "make_value: Allows to in-place move-construct value_ptr from arguments (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using pair_t = std::pair<char, S>;
+
+    S s( 7 );
+    auto a = make_value<pair_t>( 'a', std::move( s ) );
+
+    EXPECT( a->first        == 'a' );
+    EXPECT( a->second.value ==  7  );
+    EXPECT( a->second.state == move_constructed );
+    EXPECT(         s.state == moved_from       );
+#else
+    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+#endif
+}
+
+CASE( "make_value: Allows to in-place copy-construct value_ptr from initializer-list and arguments (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    S s( 7 );
+    auto a = make_value<InitList>( { 7, 8, 9, }, 'a', s );
+
+    EXPECT( a->vec[0]  ==  7  );
+    EXPECT( a->vec[1]  ==  8  );
+    EXPECT( a->vec[2]  ==  9  );
+    EXPECT( a->c       == 'a' );
+    EXPECT( a->s.value ==  7  );
+    EXPECT( a->s.state == copy_constructed );
+    EXPECT(    s.state != moved_from       );
+#else
+    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+#endif
+}
+
+CASE( "make_value: Allows to in-place move-construct value_ptr from initializer-list and arguments (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    S s( 7 );
+    auto a = make_value<InitList>( { 7, 8, 9, }, 'a', std::move( s ) );
+
+    EXPECT( a->vec[0]  ==  7  );
+    EXPECT( a->vec[1]  ==  8  );
+    EXPECT( a->vec[2]  ==  9  );
+    EXPECT( a->c       == 'a' );
+    EXPECT( a->s.value ==  7  );
+    EXPECT( a->s.state == move_constructed );
+    EXPECT(    s.state == moved_from       );
+#else
+    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+#endif
+}
+
+CASE( "std::hash<>: Allows to obtain hash (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    value_ptr<int> a( 7 );
+    value_ptr<int> b( 7 );
+
+    EXPECT( std::hash<value_ptr<int> >()( a ) == std::hash<value_ptr<int> >()( a ) );
+    EXPECT( std::hash<value_ptr<int> >()( b ) == std::hash<value_ptr<int> >()( b ) );
+#else
+    EXPECT( !!"std::hash<>: std::hash<> is not available (no C++11)" );
+#endif
+}
+
+CASE( "std::hash<>: Allows to obtain hash of content, consistent with content comparison (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && ! nsvp_CONFIG_COMPARE_POINTERS
+    value_ptr<int> d1;
+    value_ptr<int> d2;
+    value_ptr<int> a( 7 );
+    value_ptr<int> b( 7 );
+
+    EXPECT( std::hash<value_ptr<int> >()( a  ) == std::hash<value_ptr<int> >()( b  ) );
+    EXPECT( std::hash<value_ptr<int> >()( d1 ) == std::hash<value_ptr<int> >()( d2 ) );
+
+    std::unordered_set< value_ptr<int> > set;
+
+    set.insert( a );
+
+    EXPECT( set.count( b ) == 1u );
+    EXPECT( set.count( value_ptr<int>( 8 ) ) == 0u );
+#else
+    EXPECT( !!"std::hash<>: content hash is not available (no C++11, or nsvp_CONFIG_COMPARE_POINTERS is non-zero)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace hash_bytes {
+
+struct Point
+{
+    int x;
+    int y;
+
+    bool operator==( Point const & rhs ) const { return x == rhs.x && y == rhs.y; }
+};
+
+struct Padded
+{
+    char c;
+    int  i;
+};
+}
+#endif
+
+CASE( "std::hash<>: Allows to obtain hash over the bytes of trivially copyable content (C++17, nsvp_CONFIG_HASH_BYTES!=0)" )
+{
+#if nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS && nsvp_CONFIG_HASH_BYTES && ! nsvp_CONFIG_COMPARE_POINTERS
+    using hash_bytes::Point;
+
+    Point p = { 1, 2 };
+    Point q = { 2, 1 };
+
+    value_ptr<Point> a( p );
+    value_ptr<Point> b( p );
+    value_ptr<Point> c( q );
+
+    EXPECT( std::hash<value_ptr<Point> >()( a ) == std::hash<value_ptr<Point> >()( b ) );
+    EXPECT( std::hash<value_ptr<Point> >()( a ) != std::hash<value_ptr<Point> >()( c ) );
+#else
+    EXPECT( !!"std::hash<>: hash over bytes is not available (no C++17, or nsvp_CONFIG_HASH_BYTES is zero)" );
+#endif
+}
+
+CASE( "std::hash<>: Does not hash over the bytes of padded or floating-point content (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_bytes::Padded;
+
+    EXPECT_NOT( vptr::detail::hash_as_bytes<Padded>::value );
+    EXPECT_NOT( vptr::detail::hash_as_bytes<double>::value );
+#if ! nsvp_HAVE_UNIQUE_OBJECT_REPRESENTATIONS
+    EXPECT_NOT( vptr::detail::hash_as_bytes<int>::value );
+#endif
+#else
+    EXPECT( !!"std::hash<>: hash over bytes is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER
+namespace hash_cache {
+
+struct Key
+{
+    int value;
+
+    Key( int v ) : value( v ) {}
+    Key( Key const & other ) : value( other.value ) {}   // not trivially copyable
+
+    Key & operator=( Key const & other ) { value = other.value; return *this; }
+
+    bool operator==( Key const & rhs ) const { return value == rhs.value; }
+
+    static int & hashes() { static int count = 0; return count; }
+};
+
+inline std::ostream & operator<<( std::ostream & os, Key const & key )
+{
+    return os << "[Key:" << key.value << "]";
+}
+}
+
+namespace std {
+
+template<>
+struct hash< hash_cache::Key >
+{
+    size_t operator()( hash_cache::Key const & key ) const
+    {
+        ++hash_cache::Key::hashes();
+        return hash<int>()( key.value );
+    }
+};
+}
+
+namespace key_prefix {
+
+struct Name
+{
+    std::string text;
+
+    Name( char const * t ) : text( t ) {}
+
+    bool operator==( Name const & rhs ) const { ++compares(); return text == rhs.text; }
+    bool operator< ( Name const & rhs ) const { ++compares(); return text <  rhs.text; }
+
+    static int & compares() { static int count = 0; return count; }
+};
+
+struct name_key
+{
+    void operator()( Name const & name, unsigned char * key, std::size_t size ) const
+    {
+        nonstd::string_prefix_key()( name.text, key, size );
+    }
+};
+
+typedef keyed_value_ptr<Name, name_key, 4> keyed_name;
+
+struct checked_key
+{
+    void operator()( Name const & name, unsigned char * key, std::size_t size ) const
+    {
+        if ( name.text.empty() )
+            throw std::invalid_argument( "empty name" );
+
+        nonstd::string_prefix_key()( name.text, key, size );
+    }
+};
+
+inline std::ostream & operator<<( std::ostream & os, Name const & name )
+{
+    return os << "[Name:" << name.text << "]";
+}
+}
+#endif
+
+CASE( "value_ptr_less: Allows to compare value_ptr, value and pointer by content (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    value_ptr<int> de;
+    value_ptr<int> e1( 1 );
+    int            v2( 2 );
+
+    EXPECT(     value_ptr_less()( de, e1  ) );
+    EXPECT(     value_ptr_less()( e1, v2  ) );
+    EXPECT(     value_ptr_less()( e1, &v2 ) );
+    EXPECT_NOT( value_ptr_less()( &v2, e1 ) );
+    EXPECT_NOT( value_ptr_less()( de, de  ) );
+
+    EXPECT(     value_ptr_equal_to()( de, de  ) );
+    EXPECT(     value_ptr_equal_to()( e1, 1   ) );
+    EXPECT_NOT( value_ptr_equal_to()( e1, &v2 ) );
+    EXPECT_NOT( value_ptr_equal_to()( de, 0   ) );
+
+    EXPECT( value_ptr_hash()( e1 ) == value_ptr_hash()( 1 ) );
+    EXPECT( value_ptr_hash()( e1 ) == value_ptr_hash()( e1.get() ) );
+#else
+    EXPECT( !!"value_ptr_less: transparent function objects are not available (no C++11)" );
+#endif
+}
+
+CASE( "value_ptr_less: Allows heterogeneous lookup in a set of value_ptr (C++14)" )
+{
+#if nsvp_CPP14_OR_GREATER
+    std::set< value_ptr<int>, value_ptr_less > set;
+
+    set.insert( value_ptr<int>( 7 ) );
+    set.insert( value_ptr<int>( 3 ) );
+
+    int const key = 7;
+
+    EXPECT( set.count( 3    ) == 1u );
+    EXPECT( set.count( 5    ) == 0u );
+    EXPECT( **set.find( &key ) == 7 );
+    EXPECT( **set.begin() == 3 );
+#else
+    EXPECT( !!"value_ptr_less: heterogeneous lookup is not available (no C++14)" );
+#endif
+}
+
+CASE( "value_ptr_hash: Allows heterogeneous lookup in an unordered_set of value_ptr (C++20)" )
+{
+#if nsvp_CPP20_OR_GREATER && defined( __cpp_lib_generic_unordered_lookup )
+    std::unordered_set< value_ptr<int>, value_ptr_hash, value_ptr_equal_to > set;
+
+    set.insert( value_ptr<int>( 7 ) );
+
+    int const key = 7;
+
+    EXPECT( set.count( 7    ) == 1u );
+    EXPECT( set.count( 8    ) == 0u );
+    EXPECT( **set.find( &key ) == 7 );
+#else
+    EXPECT( !!"value_ptr_hash: heterogeneous unordered lookup is not available (no C++20)" );
+#endif
+}
+
+CASE( "hashed_value_ptr: Allows to compute the hash of its content once (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_cache::Key;
+
+    hashed_value_ptr<Key> a( Key( 7 ) );
+    hashed_value_ptr<Key> const & ca = a;
+
+    Key::hashes() = 0;
+
+    std::size_t h = a.hash();
+
+    EXPECT( a.hash() == h );
+    EXPECT( ca->value == 7 );
+    EXPECT( (*ca).value == 7 );
+    EXPECT( Key::hashes() == 1 );
+#if ! nsvp_CONFIG_COMPARE_POINTERS
+    EXPECT( h == std::hash<value_ptr<Key> >()( a.as_value_ptr() ) );
+#endif
+#else
+    EXPECT( !!"hashed_value_ptr: hashed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "hashed_value_ptr: Caches any hash value and agrees with the hash of value_ptr, also for a hash of 0 (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_cache::Key;
+
+    hashed_value_ptr<Key> a( Key( 0 ) );
+
+    Key::hashes() = 0;
+
+    std::size_t h = a.hash();
+
+    EXPECT( a.hash() == h );
+    EXPECT( Key::hashes() == 1 );
+    EXPECT( hashed_value_ptr<Key>( a ).hash() == h );
+    EXPECT( Key::hashes() == 1 );
+#if ! nsvp_CONFIG_COMPARE_POINTERS
+    EXPECT( h == std::hash<value_ptr<Key> >()( a.as_value_ptr() ) );
+    EXPECT( std::hash< hashed_value_ptr<Key> >()( a ) == std::hash<value_ptr<Key> >()( a.as_value_ptr() ) );
+#endif
+#else
+    EXPECT( !!"hashed_value_ptr: hashed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "hashed_value_ptr: Invalidates its cached hash at modification (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_cache::Key;
+
+    SETUP( "" ) {
+
+    hashed_value_ptr<Key> a( Key( 7 ) );
+    hashed_value_ptr<Key> b( Key( 8 ) );
+
+    std::size_t h = a.hash();
+    Key::hashes() = 0;
+
+    SECTION( "modify()"     ) { a.modify( []( Key & k ) { k.value = 8; } ); EXPECT( a.hash() == b.hash() ); EXPECT( Key::hashes() == 2 ); }
+    SECTION( "emplace()"    ) { a.emplace( 8 ); EXPECT( a.hash() == b.hash() ); }
+    SECTION( "assignment"   ) { a = Key( 8 ); EXPECT( a.hash() == b.hash() ); }
+    SECTION( "reset()"      ) { a.reset(); EXPECT( a.hash() != h ); EXPECT( a.hash() == hashed_value_ptr<Key>().hash() ); }
+    }
+#else
+    EXPECT( !!"hashed_value_ptr: hashed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "hashed_value_ptr: Invalidates its cached hash after modify() returns, also if hashed meanwhile (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_cache::Key;
+
+    hashed_value_ptr<Key> a( Key( 7 ) );
+    hashed_value_ptr<Key> b( Key( 8 ) );
+
+    a.modify( [&a]( Key & k ) { a.hash(); k.value = 8; } );
+
+    EXPECT( a.hash() == b.hash() );
+    EXPECT( a == b );
+
+    std::unordered_set< hashed_value_ptr<Key> > set;
+    set.insert( b );
+
+    EXPECT( set.count( a ) == 1u );
+
+    EXPECT_THROWS( a.modify( [&a]( Key & k ) { a.hash(); k.value = 9; throw std::runtime_error( "modify" ); } ) );
+
+    EXPECT( a.hash() == hashed_value_ptr<Key>( Key( 9 ) ).hash() );
+#else
+    EXPECT( !!"hashed_value_ptr: hashed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "hashed_value_ptr: Allows to compare and look up by content via cached hash (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using hash_cache::Key;
+
+    hashed_value_ptr<Key> a( Key( 7 ) );
+    hashed_value_ptr<Key> b( Key( 7 ) );
+    hashed_value_ptr<Key> c( Key( 8 ) );
+    hashed_value_ptr<Key> d;
+
+    EXPECT(     a == b );
+    EXPECT(     a != c );
+    EXPECT(     a != d );
+    EXPECT(     d == hashed_value_ptr<Key>() );
+
+    std::unordered_set< hashed_value_ptr<Key> > set;
+
+    set.insert( a );
+    set.insert( c );
+
+    EXPECT( set.count( b ) == 1u );
+    EXPECT( set.count( d ) == 0u );
+#else
+    EXPECT( !!"hashed_value_ptr: hashed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "keyed_value_ptr: Allows to compare by key prefix, dereferencing only on a tie (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using key_prefix::Name;
+    using key_prefix::keyed_name;
+
+    keyed_name a( Name( "apple" ) );
+    keyed_name b( Name( "banana" ) );
+    keyed_name c( Name( "applet" ) );
+    keyed_name d;
+
+    Name::compares() = 0;
+
+    EXPECT(     a <  b );
+    EXPECT(     b >  a );
+    EXPECT(     a != b );
+    EXPECT(     d <  a );
+    EXPECT(     d == keyed_name() );
+    EXPECT( Name::compares() == 0 );
+
+    EXPECT(     a <  c );
+    EXPECT(     a <= c );
+    EXPECT( Name::compares() > 0 );
+#else
+    EXPECT( !!"keyed_value_ptr: keyed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "keyed_value_ptr: Allows to sort and search a vector by content (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using key_prefix::Name;
+    using key_prefix::keyed_name;
+
+    std::vector<keyed_name> v;
+
+    v.push_back( Name( "pear"   ) );
+    v.push_back( Name( "apple"  ) );
+    v.push_back( Name( "plum"   ) );
+    v.push_back( Name( "applet" ) );
+    v.push_back( keyed_name() );
+
+    std::sort( v.begin(), v.end() );
+
+    EXPECT( ! v[0] );
+    EXPECT( v[1]->text == "apple"  );
+    EXPECT( v[2]->text == "applet" );
+    EXPECT( v[3]->text == "pear"   );
+    EXPECT( v[4]->text == "plum"   );
+
+    EXPECT(   std::binary_search( v.begin(), v.end(), keyed_name( Name( "pear" ) ) ) );
+    EXPECT( ! std::binary_search( v.begin(), v.end(), keyed_name( Name( "peach" ) ) ) );
+#else
+    EXPECT( !!"keyed_value_ptr: keyed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "keyed_value_ptr: Recomputes its key prefix at modification (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using key_prefix::Name;
+    using key_prefix::keyed_name;
+
+    SETUP( "" ) {
+
+    keyed_name a( Name( "apple" ) );
+    keyed_name b( Name( "zebra" ) );
+
+    SECTION( "modify()"   ) { a.modify( []( Name & n ) { n.text = "zebra"; } ); EXPECT( a == b ); EXPECT( std::memcmp( a.key(), "zebr", 4 ) == 0 ); }
+    SECTION( "emplace()"  ) { a.emplace( "zebra" ); EXPECT( a == b ); }
+    SECTION( "assignment" ) { a = Name( "zebra" ); EXPECT( a == b ); }
+    SECTION( "swap()"     ) { swap( a, b ); EXPECT( b < a ); EXPECT( a->text == "zebra" ); }
+    SECTION( "reset()"    ) { a.reset(); EXPECT( a == keyed_name() ); EXPECT( a.key()[0] == 0 ); }
+    }
+#else
+    EXPECT( !!"keyed_value_ptr: keyed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "keyed_value_ptr: Keeps its key consistent if modify() throws (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    using key_prefix::Name;
+    using key_prefix::keyed_name;
+    using key_prefix::checked_key;
+
+    typedef keyed_value_ptr<int, integral_key, 4> keyed_int;
+
+    SETUP( "" ) {
+    SECTION( "a throwing modification with a non-throwing KeyFn recomputes the key" )
+    {
+        keyed_int a( 5 );
 
-        EXPECT(  d1 );
-        EXPECT( !e1 );
-        EXPECT( *d1 == 42 );
-        EXPECT(  d1.get() != e1.get() );
+        EXPECT_THROWS( a.modify( []( int & v ) { v = 9; throw std::runtime_error( "modify" ); } ) );
+        EXPECT( *a == 9 );
+        EXPECT( a == keyed_int( 9 ) );
     }
-    SECTION( "swap engaged with disengaged value_ptr" )
+    SECTION( "a throwing modification with a KeyFn that may throw destroys the content" )
     {
-        swap( e1, d1 );
+        keyed_name a( Name( "apple" ) );
 
-        EXPECT(  d1 );
-        EXPECT( !e1 );
-        EXPECT( *d1 == 42 );
-        EXPECT(  d1.get() != e1.get() );
+        EXPECT_THROWS( a.modify( []( Name & n ) { n.text = "zebra"; throw std::runtime_error( "modify" ); } ) );
+        EXPECT( ! a );
+        EXPECT( a.key()[0] == 0 );
+    }
+    SECTION( "a throwing KeyFn destroys the content" )
+    {
+        keyed_value_ptr<Name, checked_key, 4> a( Name( "apple" ) );
+
+        EXPECT_THROWS_AS( a.modify( []( Name & n ) { n.text.clear(); } ), std::invalid_argument );
+        EXPECT( ! a );
+        EXPECT( a.key()[0] == 0 );
     }}
+#else
+    EXPECT( !!"keyed_value_ptr: keyed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "integral_key: Allows to order signed integers by key prefix (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    typedef keyed_value_ptr<int, integral_key, 4> keyed_int;
+
+    keyed_int m( -70000 );
+    keyed_int n( -1 );
+    keyed_int z( 0 );
+    keyed_int p( 70000 );
+
+    EXPECT( std::memcmp( m.key(), n.key(), 4 ) < 0 );
+    EXPECT( std::memcmp( n.key(), z.key(), 4 ) < 0 );
+    EXPECT( std::memcmp( z.key(), p.key(), 4 ) < 0 );
+    EXPECT( m < n );
+    EXPECT( p > z );
+#else
+    EXPECT( !!"integral_key: integral_key is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact_value_ptr: Is a 32-bit handle with value semantics (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    typedef compact_value_ptr<std::string> handle;
+
+    std::size_t const live = compact_pool<std::string>::live();
+
+    EXPECT( sizeof( handle ) == 4u );
+    {
+        handle a( std::string( "hello" ) );
+        handle b( a );
+        handle c;
+
+        EXPECT( a.index() != b.index() );
+        EXPECT( *a == *b );
+        EXPECT( compact_pool<std::string>::live() == live + 2 );
+
+        b->append( " world" );
+        c = std::move( b );
+
+        EXPECT( *a == "hello" );
+        EXPECT( *c == "hello world" );
+        EXPECT( !b );
+
+        a.reset();
+
+        EXPECT( !a );
+        EXPECT( compact_pool<std::string>::live() == live + 1 );
+    }
+    EXPECT( compact_pool<std::string>::live() == live );
+#else
+    EXPECT( !!"compact_value_ptr: compact_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact_value_ptr: Allows to compare by content (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    compact_value_ptr<int> a( 7 );
+    compact_value_ptr<int> b( 7 );
+    compact_value_ptr<int> c( 8 );
+    compact_value_ptr<int> d;
+
+    EXPECT( a == b );
+    EXPECT( a != c );
+    EXPECT( a <  c );
+    EXPECT( c >  a );
+    EXPECT( d <  a );
+    EXPECT( d == compact_value_ptr<int>() );
+#else
+    EXPECT( !!"compact_value_ptr: compact_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact_pool: Grows across chunks and reuses released indices (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    typedef compact_value_ptr<long> handle;
+
+    std::vector<handle> v;
+
+    for ( long i = 0; i < 5000; ++i )
+        v.push_back( handle( i ) );
+
+    long sum = 0;
+    for ( auto const & h : v )
+        sum += *h;
+
+    EXPECT( sum == 5000L * 4999 / 2 );
+
+    handle::index_type const index = v[17].index();
+
+    v[17].reset();
+    v[17].emplace( 42L );
+
+    EXPECT( v[17].index() == index );
+    EXPECT( *v[17] == 42L );
+    EXPECT( *v[4999] == 4999L );
+#else
+    EXPECT( !!"compact_pool: compact_pool is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact_pool: Creates and destroys from several threads, also across threads (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    struct Item { int thread; int value; };
+
+    typedef compact_value_ptr<Item> handle;
+    typedef compact_pool<Item> pool;
+
+    int const threads = 4;
+    int const count   = 3000;
+
+    std::vector< std::vector<handle> > made( threads );
+    std::vector<std::thread> workers;
+
+    for ( int t = 0; t < threads; ++t )
+    {
+        workers.emplace_back( [&made, t, count]
+        {
+            for ( int i = 0; i < count; ++i )
+            {
+                made[ static_cast<std::size_t>(t) ].push_back( handle( Item{ t, i } ) );
+
+                if ( i % 3 == 2 )
+                    made[ static_cast<std::size_t>(t) ].pop_back();
+            }
+        } );
+    }
+
+    for ( auto & w : workers )
+        w.join();
+
+    EXPECT( pool::live() == std::size_t( threads * ( count - count / 3 ) ) );
+
+    bool intact = true;
+    for ( int t = 0; t < threads; ++t )
+    {
+        int expected = 0;
+        for ( auto const & h : made[ static_cast<std::size_t>(t) ] )
+        {
+            intact = intact && h->thread == t && h->value == expected;
+            expected += expected % 3 == 1 ? 2 : 1;
+        }
+    }
+
+    EXPECT( intact );
+
+    // destroy on threads other than the creating ones:
+
+    workers.clear();
+    for ( int t = 0; t < threads; ++t )
+    {
+        workers.emplace_back( [&made, t, threads]
+        {
+            made[ static_cast<std::size_t>( ( t + 1 ) % threads ) ].clear();
+        } );
+    }
+
+    for ( auto & w : workers )
+        w.join();
+
+    EXPECT( pool::live() == 0u );
+
+    handle const h( Item{ 7, 42 } );
+
+    EXPECT( h->value == 42 );
+#else
+    EXPECT( !!"compact_pool: compact_pool is not available (no C++11)" );
+#endif
+}
+
+CASE( "compact_pool: Returns the indices released by a thread at its exit (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER
+    struct Released { int value; };
+
+    typedef compact_value_ptr<Released> handle;
+    typedef compact_pool<Released> pool;
+
+    // three batches of the thread free lists: the releasing thread keeps
+    // two of them, the acquiring thread takes all three from the shared list:
+
+    int const count = 192;
+
+    std::vector<handle> made;
+    std::set<handle::index_type> released;
+
+    for ( int i = 0; i < count; ++i )
+    {
+        made.push_back( handle( Released{ i } ) );
+        released.insert( made.back().index() );
+    }
+
+    std::thread( [&made] { made.clear(); } ).join();
+
+    EXPECT( pool::live() == 0u );
+
+    std::vector<handle> reused;
+
+    std::thread( [&reused, count]
+    {
+        for ( int i = 0; i < count; ++i )
+            reused.push_back( handle( Released{ i } ) );
+    } ).join();
+
+    bool all_reused = true;
+    for ( auto const & h : reused )
+        all_reused = all_reused && released.count( h.index() ) == 1;
+
+    EXPECT( all_reused );
+    EXPECT( pool::live() == std::size_t( count ) );
+#else
+    EXPECT( !!"compact_pool: compact_pool is not available (no C++11)" );
+#endif
 }
 
-namespace compare_pointers {
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+namespace cold {
+
+struct Record
+{
+    int id;
+    char text[1000];
+    double history[300];
+    unsigned noise[64];
+
+    bool operator==( Record const & rhs ) const { return std::memcmp( this, &rhs, sizeof rhs ) == 0; }
+};
+
+inline Record make_record( int id, unsigned seed )
+{
+    Record r;
+    std::memset( &r, 0, sizeof r );
+    r.id = id;
+    std::strcpy( r.text, "historic record, historic record, historic record" );
+    for ( int i = 0; i < 300; ++i )
+        r.history[i] = i % 7;
+    for ( int i = 0; i < 64; ++i )
+        r.noise[i] = seed = seed * 1103515245u + 12345u;
+    return r;
+}
+
+struct Noise
+{
+    unsigned bits[256];
+};
+
+inline std::ostream & operator<<( std::ostream & os, Record const & r )
+{
+    return os << "[Record:" << r.id << "]";
+}
+}
+#endif
+
+CASE( "compressed_value_ptr: Allows to keep a trivially copyable value compressed (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+    using namespace cold;
+
+    Record const record = make_record( 7, 1u );
+    compressed_value_ptr<Record> a( record );
+    compressed_value_ptr<Record> b( a );
+
+    EXPECT( a.compressed_size() * 3 < sizeof( Record ) );
+    EXPECT( a->id == 7 );
+    EXPECT( ( *a == record ) );
+    EXPECT( ( a.load() == record ) );
+    EXPECT( ( b == a ) );
+
+    b.reset();
+
+    EXPECT( !b );
+    EXPECT( a.has_value() );
+#else
+    EXPECT( !!"compressed_value_ptr: compressed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "compressed_value_ptr: Stores incompressible content as is (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+    using namespace cold;
+
+    Noise noise;
+    unsigned seed = 42u;
+
+    for ( auto & bits : noise.bits )
+        bits = seed = seed * 1103515245u + 12345u;
+
+    compressed_value_ptr<Noise> a( noise );
+
+    EXPECT( a.compressed_size() <= sizeof( Noise ) + 1 );
+    EXPECT( std::memcmp( a.get(), &noise, sizeof noise ) == 0 );
+#else
+    EXPECT( !!"compressed_value_ptr: compressed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+CASE( "compressed_value_ptr: Keeps two inflated values accessible and reflects modification (C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_IS_TRIVIALLY_COPYABLE
+    using namespace cold;
+
+    std::vector< compressed_value_ptr<Record> > v;
+
+    for ( int i = 0; i < 6; ++i )
+        v.push_back( make_record( i, unsigned( i ) ) );
+
+    for ( int i = 0; i < 6; ++i )
+    {
+        for ( int k = 0; k < 6; ++k )
+        {
+            Record const & a = *v[ std::size_t( i ) ];
+            Record const & b = *v[ std::size_t( k ) ];
+
+            EXPECT( ( a.id == i && b.id == k ) );
+        }
+    }
+
+    v[3].modify( []( Record & r ) { r.id = 33; } );
+
+    EXPECT( v[3]->id == 33 );
+    EXPECT( v[3]->history[6] == 6.0 );
+    EXPECT( v[2] != v[3] );
+#else
+    EXPECT( !!"compressed_value_ptr: compressed_value_ptr is not available (no C++11)" );
+#endif
+}
+
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+namespace spill {
+
+struct Doc
+{
+    int id;
+    char body[4000];
+};
+
+inline Doc make_doc( int id )
+{
+    Doc d;
+    d.id = id;
+    std::memset( d.body, 'a' + id % 26, sizeof d.body );
+    return d;
+}
+
+// restore an unlimited budget at end of scope:
+
+struct budget_scope
+{
+    explicit budget_scope( std::size_t bytes ) { spill_manager::instance().budget( bytes ); }
+    ~budget_scope() { spill_manager::instance().budget( std::size_t( -1 ) ); }
+};
+}
+#endif
+
+CASE( "spillable_value_ptr: Spills content beyond the budget and faults it back in (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace spill;
+
+    std::size_t const before = spill_manager::instance().resident_bytes();
+    budget_scope budget( before + 3 * sizeof( Doc ) );
 
-    struct C
-    {
-        int * operator()( int const & x ) const
-        {
-            static int a[3];
-            return & ( a[x] = -x );
-        }
-    };
-    struct D
+    std::vector< spillable_value_ptr<Doc> > docs;
+
+    for ( int i = 0; i < 10; ++i )
+        docs.push_back( spillable_value_ptr<Doc>( make_doc( i ) ) );
+
+    EXPECT( spill_manager::instance().resident_bytes() <= before + 3 * sizeof( Doc ) );
+    EXPECT_NOT( docs[0].resident() );
+    EXPECT(     docs[9].resident() );
+
+    for ( int i = 0; i < 10; ++i )
     {
-        void operator()( int * ptr ) const {}
-    };
+        Doc const doc = docs[ std::size_t( i ) ].load();
+        EXPECT( ( doc.id == i && doc.body[3999] == char( 'a' + i ) ) );
+    }
+    EXPECT( spill_manager::instance().resident_bytes() <= before + 3 * sizeof( Doc ) );
+#else
+    EXPECT( !!"spillable_value_ptr: spillable_value_ptr is not available (no POSIX or no C++11)" );
+#endif
 }
 
-CASE( "value_ptr: Provides relational operators (non-member, pointer comparison: nsvp_CONFIG_COMPARE_POINTERS!=0)" )
+CASE( "spillable_value_ptr: Spills the least recently used content first (POSIX, C++11)" )
 {
-#if nsvp_CONFIG_COMPARE_POINTERS
-    using namespace compare_pointers;
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace spill;
 
-    SETUP( "" ) {
+    std::size_t const before = spill_manager::instance().resident_bytes();
+    budget_scope budget( before + 3 * sizeof( Doc ) );
 
-    value_ptr<int, C, D> e1( 1 );
-    value_ptr<int, C, D> e2( 2 );
+    std::vector< spillable_value_ptr<Doc> > docs;
 
-    SECTION( "engaged == engaged" ) { EXPECT(     e1 == e1  ); }
-    SECTION( "engaged != engaged" ) { EXPECT(     e1 != e2  ); }
+    for ( int i = 0; i < 5; ++i )
+        docs.push_back( spillable_value_ptr<Doc>( make_doc( i ) ) );
 
-    SECTION( "engaged <  engaged" ) { EXPECT(     e1 <  e2  ); }
-    SECTION( "engaged <= engaged" ) { EXPECT(     e1 <= e1  ); }
-    SECTION( "engaged <= engaged" ) { EXPECT(     e1 <= e2  ); }
+    EXPECT( docs[2].load().id == 2 );
 
-    SECTION( "engaged >  engaged" ) { EXPECT(     e2 >  e1  ); }
-    SECTION( "engaged >= engaged" ) { EXPECT(     e1 >= e1  ); }
-    SECTION( "engaged >= engaged" ) { EXPECT(     e2 >= e1  ); }
+    docs.push_back( spillable_value_ptr<Doc>( make_doc( 5 ) ) );
 
-#if nsvp_HAVE_NULLPTR
-    auto np = nullptr;
+    EXPECT(     docs[2].resident() );
+    EXPECT_NOT( docs[3].resident() );
 
-    SECTION( "engaged == nullptr" ) { EXPECT_NOT( e1 == np ); }
-    SECTION( "engaged != nullptr" ) { EXPECT(     e1 != np ); }
+    EXPECT( docs[0].load().id == 0 );
 
-    SECTION( "engaged <  nullptr" ) { EXPECT_NOT( e1 <  np ); }
-    SECTION( "engaged <= nullptr" ) { EXPECT_NOT( e1 <= np ); }
+    EXPECT(     docs[0].resident() );
+    EXPECT_NOT( docs[4].resident() );
+    EXPECT( spill_manager::instance().resident_bytes() <= before + 3 * sizeof( Doc ) );
+#else
+    EXPECT( !!"spillable_value_ptr: spillable_value_ptr is not available (no POSIX or no C++11)" );
+#endif
+}
 
-    SECTION( "engaged >  nullptr" ) { EXPECT(     e1 >  np ); }
-    SECTION( "engaged >= nullptr" ) { EXPECT(     e1 >= np ); }
+CASE( "spillable_value_ptr: Keeps pinned content resident and retains modification (POSIX, C++11)" )
+{
+#if nsvp_CPP11_OR_GREATER && nsvp_HAVE_POSIX_IO
+    using namespace spill;
 
-    SECTION( "nullptr == engaged" ) { EXPECT_NOT( np == e1 ); }
-    SECTION( "nullptr != engaged" ) { EXPECT(     np != e1 ); }
+    std::size_t const before = spill_manager::instance().resident_bytes();
+    budget_scope budget( before + 2 * sizeof( Doc ) );
 
-    SECTION( "nullptr <  engaged" ) { EXPECT(     np <  e1 ); }
-    SECTION( "nullptr <= engaged" ) { EXPECT(     np <= e1 ); }
+    spillable_value_ptr<Doc> a( make_doc( 1 ) );
+    std::vector< spillable_value_ptr<Doc> > others;
+    {
+        spill_pin<Doc> pin = a.pin();
+        pin->id = 100;
 
-    SECTION( "nullptr >  engaged" ) { EXPECT_NOT( np >  e1 ); }
-    SECTION( "nullptr >= engaged" ) { EXPECT_NOT( np >= e1 ); }
-#endif
+        for ( int i = 0; i < 5; ++i )
+            others.push_back( spillable_value_ptr<Doc>( make_doc( i ) ) );
+
+        EXPECT( a.resident() );
+        EXPECT( pin->id == 100 );
     }
+
+    others.push_back( spillable_value_ptr<Doc>( make_doc( 6 ) ) );
+    others.push_back( spillable_value_ptr<Doc>( make_doc( 7 ) ) );
+
+    EXPECT_NOT( a.resident() );
+
+    spillable_value_ptr<Doc> const copy( a );
+
+    EXPECT( copy.pin()->id == 100 );
+    EXPECT( a.load().id == 100 );
 #else
-    EXPECT( !!"value_ptr: pointer comparison is not available (nsvp_CONFIG_COMPARE_POINTERS undefined or 0)" );
+    EXPECT( !!"spillable_value_ptr: spillable_value_ptr is not available (no POSIX or no C++11)" );
 #endif
 }
 
-CASE( "value_ptr: Provides relational operators (non-member, value comparison: nsvp_CONFIG_COMPARE_POINTERS==0)" )
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+namespace stats {
+
+struct StatsTracked
 {
-#if ! nsvp_CONFIG_COMPARE_POINTERS
-    using namespace compare_pointers;
+    int value;
+    StatsTracked( int v ) : value( v ) {}
+};
 
-    SETUP( "" ) {
+struct StatsPeak
+{
+    int value;
+    StatsPeak( int v ) : value( v ) {}
+};
 
-    value_ptr<int> de;
-    value_ptr<int> e1( 1 );
-    value_ptr<int> e2( 2 );
+struct StatsLate
+{
+    int value;
+    StatsLate( int v ) : value( v ) {}
+};
 
-    SECTION( "engaged    == engaged"    ) { EXPECT(     e1 == e1  ); }
-    SECTION( "engaged    != engaged"    ) { EXPECT(     e1 != e2  ); }
+// thread_local owner constructed before the first statistics event of the
+// thread, hence destroyed after the thread's shard has been published:
 
-    SECTION( "engaged    <  engaged"    ) { EXPECT(     e1 <  e2  ); }
-    SECTION( "engaged    <= engaged"    ) { EXPECT(     e1 <= e1  ); }
-    SECTION( "engaged    <= engaged"    ) { EXPECT(     e1 <= e2  ); }
+struct late_owner
+{
+    value_ptr<StatsLate> vp;
+};
 
-    SECTION( "engaged    >  engaged"    ) { EXPECT(     e2 >  e1  ); }
-    SECTION( "engaged    >= engaged"    ) { EXPECT(     e1 >= e1  ); }
-    SECTION( "engaged    >= engaged"    ) { EXPECT(     e2 >= e1  ); }
+inline late_owner & late_owner_of_thread()
+{
+    static thread_local late_owner owner;
+    return owner;
+}
 
-    SECTION( "disengaged == disengaged" ) { EXPECT(     de == de  ); }
-    SECTION( "disengaged != disengaged" ) { EXPECT_NOT( de != de  ); }
-    SECTION( "disengaged <  disengaged" ) { EXPECT_NOT( de <  de  ); }
-    SECTION( "disengaged <= disengaged" ) { EXPECT(     de <= de  ); }
-    SECTION( "disengaged >  disengaged" ) { EXPECT_NOT( de >  de  ); }
-    SECTION( "disengaged >= disengaged" ) { EXPECT(     de >= de  ); }
+template< class T >
+value_ptr_stats::entry stats_of()
+{
+    std::string const name = vptr::detail::type_name_c_str<T>();
+    std::vector<value_ptr_stats::entry> const all = value_ptr_stats::snapshot();
 
-    SECTION( "engaged    == disengaged" ) { EXPECT_NOT( e1 == de  ); }
-    SECTION( "engaged    != disengaged" ) { EXPECT(     e1 != de  ); }
-    SECTION( "engaged    <  disengaged" ) { EXPECT_NOT( e1 <  de  ); }
-    SECTION( "engaged    <= disengaged" ) { EXPECT_NOT( e1 <= de  ); }
-    SECTION( "engaged    >  disengaged" ) { EXPECT(     e1 >  de  ); }
-    SECTION( "engaged    >= disengaged" ) { EXPECT(     e1 >= de  ); }
+    for ( auto const & e : all )
+        if ( e.type == name )
+            return e;
 
-    SECTION( "disengaged == engaged"    ) { EXPECT_NOT( de == e1  ); }
-    SECTION( "disengaged != engaged"    ) { EXPECT(     de != e1  ); }
-    SECTION( "disengaged <  engaged"    ) { EXPECT(     de <  e1  ); }
-    SECTION( "disengaged <= engaged"    ) { EXPECT(     de <= e1  ); }
-    SECTION( "disengaged >  engaged"    ) { EXPECT_NOT( de >  e1  ); }
-    SECTION( "disengaged >= engaged"    ) { EXPECT_NOT( de >= e1  ); }
+    return value_ptr_stats::entry();
+}
+}
+#endif
+
+CASE( "value_ptr_stats: Counts clones, adoptions, releases and deletes per type (C++11, nsvp_CONFIG_STATS!=0)" )
+{
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+    using stats::StatsTracked;
+    {
+        value_ptr<StatsTracked> a( StatsTracked( 1 ) );
+        value_ptr<StatsTracked> b( a );
+        value_ptr<StatsTracked> c( b.release() );
+
+        value_ptr_stats::entry const e = stats::stats_of<StatsTracked>();
+
+        EXPECT( e.clones   == 2u );
+        EXPECT( e.adopts   == 1u );
+        EXPECT( e.releases == 1u );
+        EXPECT( e.live     == 2u );
     }
+    value_ptr_stats::entry const e = stats::stats_of<StatsTracked>();
+
+    EXPECT( e.type.find( "StatsTracked" ) != std::string::npos );
+    EXPECT( e.size == sizeof( StatsTracked ) );
+    EXPECT( e.deletes == 2u );
+    EXPECT( e.live    == 0u );
+    EXPECT( e.bytes_allocated == 2 * sizeof( StatsTracked ) );
 #else
-    EXPECT( !!"value_ptr: value comparison is not available (nsvp_CONFIG_COMPARE_POINTERS is non-zero)" );
+    EXPECT( !!"value_ptr_stats: statistics are not enabled (nsvp_CONFIG_STATS==0 or no C++11)" );
 #endif
 }
 
-CASE( "value_ptr: Provides relational operators (non-member, mixed value comparison: nsvp_CONFIG_COMPARE_POINTERS==0)" )
+CASE( "value_ptr_stats: Reports the peak of live objects (C++11, nsvp_CONFIG_STATS!=0)" )
 {
-#if ! nsvp_CONFIG_COMPARE_POINTERS
-    using namespace compare_pointers;
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+    using stats::StatsPeak;
+    {
+        std::vector< value_ptr<StatsPeak> > v;
 
-    SETUP( "" ) {
+        for ( int i = 0; i < 100; ++i )
+            v.push_back( value_ptr<StatsPeak>( StatsPeak( i ) ) );
+    }
+    value_ptr_stats::entry const e = stats::stats_of<StatsPeak>();
+    std::uint64_t const batch = vptr::detail::type_stats::batch;
 
-    value_ptr<int> e1( 1 );
-    value_ptr<int> e2( 2 );
-    int            v1( 1 );
-    int            v2( 2 );
+    EXPECT( e.live == 0u );
+    EXPECT( e.peak <= 100u );
+    EXPECT( e.peak >= 100u - batch );
+#else
+    EXPECT( !!"value_ptr_stats: statistics are not enabled (nsvp_CONFIG_STATS==0 or no C++11)" );
+#endif
+}
 
-    SECTION( "engaged == value"   ) { EXPECT(   e1 == v1  ); }
-    SECTION( "engaged != value"   ) { EXPECT(   e1 != v2  ); }
-    SECTION( "engaged <  value"   ) { EXPECT(   e1 <  v2  ); }
-    SECTION( "engaged <= value"   ) { EXPECT(   e1 <= v1  ); }
-    SECTION( "engaged <= value"   ) { EXPECT(   e1 <= v2  ); }
-    SECTION( "engaged >  value"   ) { EXPECT(   e2 >  v1  ); }
-    SECTION( "engaged >= value"   ) { EXPECT(   e1 >= v1  ); }
-    SECTION( "engaged >= value"   ) { EXPECT(   e2 >= v1  ); }
+CASE( "value_ptr_stats: Counts a delete by a thread_local object at thread exit (C++11, nsvp_CONFIG_STATS!=0)" )
+{
+#if nsvp_CONFIG_STATS && nsvp_CPP11_OR_GREATER
+    using stats::StatsLate;
 
-    SECTION( "value   == engaged" ) { EXPECT(   v1 == e1  ); }
-    SECTION( "value   != engaged" ) { EXPECT(   v2 != e1  ); }
-    SECTION( "value   <  engaged" ) { EXPECT(   v1 <  e2  ); }
-    SECTION( "value   <= engaged" ) { EXPECT(   v1 <= e1  ); }
-    SECTION( "value   <= engaged" ) { EXPECT(   v1 <= e2  ); }
-    SECTION( "value   >  engaged" ) { EXPECT(   v2 >  e1  ); }
-    SECTION( "value   >= engaged" ) { EXPECT(   v1 >= e1  ); }
-    SECTION( "value   >= engaged" ) { EXPECT(   v2 >= e1  ); }
-    }
+    std::thread( []
+    {
+        stats::late_owner & owner = stats::late_owner_of_thread();
+        owner.vp = value_ptr<StatsLate>( StatsLate( 1 ) );
+    } ).join();
+
+    value_ptr_stats::entry const e = stats::stats_of<StatsLate>();
+
+    EXPECT( e.clones  == 1u );
+    EXPECT( e.deletes == 1u );
+    EXPECT( e.live    == 0u );
+    EXPECT( vptr::detail::type_stats::of<StatsLate>().live() == 0 );
 #else
-    EXPECT( !!"value_ptr: value comparison is not available (nsvp_CONFIG_COMPARE_POINTERS is non-zero)" );
+    EXPECT( !!"value_ptr_stats: statistics are not enabled (nsvp_CONFIG_STATS==0 or no C++11)" );
 #endif
 }
 
-CASE( "make_value: Allows to copy-construct value_ptr" )
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER
+namespace audit {
+
+struct AuditTracked
 {
-    S s( 7 );
+    int value[4];
+    AuditTracked( int v ) : value() { value[0] = v; }
+};
 
-    EXPECT( make_value( s )->value == 7          );
-    EXPECT(                s.state != moved_from );
+struct AuditNode
+{
+    int value;
+    value_ptr<AuditNode> next;
+    AuditNode( int v ) : value( v ), next() {}
+};
+
+template< class T >
+std::vector<copy_audit::entry> audit_of()
+{
+    std::string const name = vptr::detail::type_name_c_str<T>();
+    std::vector<copy_audit::entry> result;
+
+    for ( auto const & e : copy_audit::snapshot() )
+        if ( e.type == name )
+            result.push_back( e );
+
+    return result;
 }
+}
+#endif
 
-CASE( "make_value: Allows to move-construct value_ptr (C++11)" )
+CASE( "copy_audit: Aggregates deep copies by call site and element type (C++11, nsvp_CONFIG_COPY_AUDIT!=0)" )
 {
-#if nsvp_CPP11_OR_GREATER
-    S s( 7 );
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER && nsvp_CONFIG_COPY_AUDIT_SAMPLE == 1
+    using audit::AuditTracked;
+    copy_audit::clear();
 
-    EXPECT( make_value( std::move( s ) )->value == 7          );
-    EXPECT(                             s.state == moved_from );
+    value_ptr<AuditTracked> a( AuditTracked( 1 ) );
+
+    for ( int i = 0; i < 3; ++i )
+    {
+        value_ptr<AuditTracked> b( a );
+    }
+
+    value_ptr<AuditTracked> c;
+    c = a;
+    value_ptr<AuditTracked> d( std::move( c ) );
+
+    std::vector<copy_audit::entry> const sites = audit::audit_of<AuditTracked>();
+
+#if nsvp_HAVE_BACKTRACE
+    EXPECT( sites.size() == 2u );
+    EXPECT( sites[0].copies == 3u );
+    EXPECT( sites[0].bytes  == 3 * sizeof( AuditTracked ) );
+    EXPECT( sites[1].copies == 1u );
+    EXPECT( ( sites[0].frames != sites[1].frames ) );
+    EXPECT( ! sites[0].frames.empty() );
 #else
-    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+    EXPECT( sites.size() == 1u );
+    EXPECT( sites[0].copies == 4u );
+#endif
+    EXPECT( sites[0].size == sizeof( AuditTracked ) );
+
+    copy_audit::clear();
+
+    EXPECT( audit::audit_of<AuditTracked>().empty() );
+#else
+    EXPECT( !!"copy_audit: copy audit is not enabled (nsvp_CONFIG_COPY_AUDIT==0, sampled, or no C++11)" );
 #endif
 }
 
-CASE( "make_value: Allows to in-place copy-construct value_ptr from arguments (C++11)" )
+CASE( "copy_audit: Records a deep copy of a tree once, with the bytes of all its nodes (C++11, nsvp_CONFIG_COPY_AUDIT!=0)" )
 {
-#if nsvp_CPP11_OR_GREATER
-    using pair_t = std::pair<char, S>;
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER && nsvp_CONFIG_COPY_AUDIT_SAMPLE == 1
+    using audit::AuditNode;
+    copy_audit::clear();
 
-    S s( 7);
-    auto a = make_value<pair_t>( 'a', s );
+    value_ptr<AuditNode> list( AuditNode( 1 ) );
+    list->next = AuditNode( 2 );
+    list->next->next = AuditNode( 3 );
 
-    EXPECT( a->first        == 'a' );
-    EXPECT( a->second.value ==  7  );
-    EXPECT( a->second.state == copy_constructed );
-    EXPECT(         s.state != moved_from       );
+    value_ptr<AuditNode> copy( list );
+
+    std::vector<copy_audit::entry> const sites = audit::audit_of<AuditNode>();
+
+    EXPECT( sites.size() == 1u );
+    EXPECT( sites[0].copies == 1u );
+    EXPECT( sites[0].bytes  == 3 * sizeof( AuditNode ) );
+    EXPECT( sites[0].size   == sizeof( AuditNode ) );
+
+    copy_audit::clear();
 #else
-    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+    EXPECT( !!"copy_audit: copy audit is not enabled (nsvp_CONFIG_COPY_AUDIT==0, sampled, or no C++11)" );
 #endif
 }
 
-CASE( "make_value: Allows to in-place move-construct value_ptr from arguments (C++11)" )
+CASE( "copy_audit: Reports call sites ranked by bytes copied (C++11, nsvp_CONFIG_COPY_AUDIT!=0)" )
 {
-#if nsvp_CPP11_OR_GREATER
-    using pair_t = std::pair<char, S>;
+#if nsvp_CONFIG_COPY_AUDIT && nsvp_CPP11_OR_GREATER
+    using audit::AuditTracked;
+    copy_audit::clear();
 
-    S s( 7 );
-    auto a = make_value<pair_t>( 'a', std::move( s ) );
+    value_ptr<AuditTracked> a( AuditTracked( 1 ) );
 
-    EXPECT( a->first        == 'a' );
-    EXPECT( a->second.value ==  7  );
-    EXPECT( a->second.state == move_constructed );
-    EXPECT(         s.state == moved_from       );
+    for ( unsigned i = 0; i < 2 * copy_audit::sample_rate(); ++i )
+    {
+        value_ptr<AuditTracked> b( a );
+    }
+
+    std::FILE * out = std::tmpfile();
+    copy_audit::report( out, 1 );
+    std::rewind( out );
+
+    std::string text;
+    char buffer[ 256 ];
+    while ( std::fgets( buffer, sizeof( buffer ), out ) )
+        text += buffer;
+    std::fclose( out );
+
+    EXPECT( text.find( "value_ptr copy audit: 1 call site(s)" ) == 0u );
+    EXPECT( text.find( "#1: " + std::to_string( 2 * copy_audit::sample_rate() ) + " copies" ) != std::string::npos );
+    EXPECT( text.find( "AuditTracked" ) != std::string::npos );
+    EXPECT( text.find( "#2:" ) == std::string::npos );
+
+    copy_audit::clear();
 #else
-    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+    EXPECT( !!"copy_audit: copy audit is not enabled (nsvp_CONFIG_COPY_AUDIT==0 or no C++11)" );
 #endif
 }
 
-CASE( "make_value: Allows to in-place copy-construct value_ptr from initializer-list and arguments (C++11)" )
+CASE( "interner: Allows to intern equal values to a single canonical copy (C++11)" )
 {
 #if nsvp_CPP11_OR_GREATER
-    S s( 7 );
-    auto a = make_value<InitList>( { 7, 8, 9, }, 'a', s );
-
-    EXPECT( a->vec[0]  ==  7  );
-    EXPECT( a->vec[1]  ==  8  );
-    EXPECT( a->vec[2]  ==  9  );
-    EXPECT( a->c       == 'a' );
-    EXPECT( a->s.value ==  7  );
-    EXPECT( a->s.state == copy_constructed );
-    EXPECT(    s.state != moved_from       );
+    interner<std::string> pool;
+
+    std::string hello( "hello" );
+
+    interned<std::string> a = pool.intern( hello );
+    interned<std::string> b = pool.intern( std::string( "hello" ) );
+    interned<std::string> c = pool.intern( std::string( "world" ) );
+
+    EXPECT(  a == b );
+    EXPECT(  a != c );
+    EXPECT(  a.get() == b.get() );
+    EXPECT(  a.get() != &hello );
+    EXPECT( *a == "hello" );
+    EXPECT(  c->size() == 5u );
+    EXPECT(  pool.size() == 2u );
+    EXPECT(  std::hash<interned<std::string> >()( a ) == std::hash<interned<std::string> >()( b ) );
 #else
-    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+    EXPECT( !!"interner: interner is not available (no C++11)" );
 #endif
 }
 
-CASE( "make_value: Allows to in-place move-construct value_ptr from initializer-list and arguments (C++11)" )
+CASE( "interner: Allows to intern via a sharded interner for concurrent producers (C++11)" )
 {
 #if nsvp_CPP11_OR_GREATER
-    S s( 7 );
-    auto a = make_value<InitList>( { 7, 8, 9, }, 'a', std::move( s ) );
+    sharded_interner<int, 4> pool;
 
-    EXPECT( a->vec[0]  ==  7  );
-    EXPECT( a->vec[1]  ==  8  );
-    EXPECT( a->vec[2]  ==  9  );
-    EXPECT( a->c       == 'a' );
-    EXPECT( a->s.value ==  7  );
-    EXPECT( a->s.state == move_constructed );
-    EXPECT(    s.state == moved_from       );
+    interned<int> a = pool.intern( 7 );
+    interned<int> b = pool.intern( 7 );
+    interned<int> c = pool.intern( 8 );
+
+    EXPECT(  a == b );
+    EXPECT(  a != c );
+    EXPECT( *c == 8 );
+    EXPECT(  pool.size() == 2u );
+
+    pool.clear();
+
+    EXPECT(  pool.size() == 0u );
 #else
-    EXPECT( !!"value_ptr: in-place construction is not available (no C++11)" );
+    EXPECT( !!"interner: sharded_interner is not available (no C++11)" );
 #endif
 }
 
-CASE( "std::hash<>: Allows to obtain hash (C++11)" )
+CASE( "interner: Yields one canonical copy per value to producers on several threads (C++11)" )
 {
 #if nsvp_CPP11_OR_GREATER
-    value_ptr<int> a( 7 );
-    value_ptr<int> b( 7 );
+    sharded_interner<std::string, 4> pool;
 
-    EXPECT( std::hash<value_ptr<int> >()( a ) == std::hash<value_ptr<int> >()( a ) );
-    EXPECT( std::hash<value_ptr<int> >()( b ) == std::hash<value_ptr<int> >()( b ) );
-    EXPECT( std::hash<value_ptr<int> >()( a ) != std::hash<value_ptr<int> >()( b ) );
+    int const threads = 4;
+    int const values  = 500;
+
+    std::vector< std::vector< interned<std::string> > > seen( threads );
+    std::vector<std::thread> producers;
+
+    for ( int t = 0; t < threads; ++t )
+    {
+        producers.emplace_back( [&pool, &seen, t, values]
+        {
+            std::vector< interned<std::string> > & mine = seen[ static_cast<std::size_t>(t) ];
+
+            // all threads intern the same values, each starting elsewhere:
+
+            for ( int i = 0; i < values; ++i )
+                mine.push_back( pool.intern( std::to_string( ( i + t * values / threads ) % values ) ) );
+        } );
+    }
+
+    for ( auto & p : producers )
+        p.join();
+
+    EXPECT( pool.size() == std::size_t( values ) );
+
+    bool identical = true;
+    for ( int t = 1; t < threads; ++t )
+    {
+        for ( int i = 0; i < values; ++i )
+        {
+            int const k = ( i + t * values / threads ) % values;
+            interned<std::string> const & first = seen[0][ static_cast<std::size_t>(k) ];
+            interned<std::string> const & other = seen[ static_cast<std::size_t>(t) ][ static_cast<std::size_t>(i) ];
+
+            identical = identical && other.get() == first.get() && *other == std::to_string( k );
+        }
+    }
+
+    EXPECT( identical );
 #else
-    EXPECT( !!"std::hash<>: std::hash<> is not available (no C++11)" );
+    EXPECT( !!"interner: sharded_interner is not available (no C++11)" );
 #endif
 }
 